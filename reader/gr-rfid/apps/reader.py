@@ -21,6 +21,18 @@ import time
 import sys
 
 DEBUG = False
+# Decoder debug output (port 1): rfid.DEBUG_TAP_OFF / _EVERY_NTH / _FAILED_CRC / _ENCODING
+DEBUG_TAP = rfid.DEBUG_TAP_OFF
+DEBUG_TAP_INTERVAL = 100  # for DEBUG_TAP_EVERY_NTH
+DEBUG_TAP_ENCODING = 8    # for DEBUG_TAP_ENCODING
+# Run the matched filter and decimation inside the gate instead of a separate FIR block
+FUSED_MATCHED_FILTER = True
+# Rate adaptation policy: "fixed", "arf", "minstrel", "blink", "mobirate", "adabs"
+# ("" = the one enabled in global_vars.h)
+RATE_POLICY = ""
+# Let the reader emit complex samples scaled by the Tx amplitude instead of
+# reader -> multiply_rta_ff -> float_to_complex
+FUSED_TX = True
 class reader_top_block(gr.top_block):
 
   # Configure usrp source
@@ -83,8 +95,14 @@ class reader_top_block(gr.top_block):
     self.file_sink_source         = blocks.file_sink(gr.sizeof_gr_complex*1, "../misc/data/source", False)
     self.file_sink_matched_filter = blocks.file_sink(gr.sizeof_gr_complex*1, "../misc/data/matched_filter", False)
     self.file_sink_gate           = blocks.file_sink(gr.sizeof_gr_complex*1, "../misc/data/gate", False)
-    self.file_sink_decoder        = blocks.file_sink(gr.sizeof_gr_complex*1, "../misc/data/decoder", False)
-    self.file_sink_reader         = blocks.file_sink(gr.sizeof_float*1,      "../misc/data/reader", False)
+    if DEBUG_TAP != rfid.DEBUG_TAP_OFF:
+      self.file_sink_decoder      = blocks.file_sink(gr.sizeof_gr_complex*1, "../misc/data/decoder", False)
+    else:
+      self.file_sink_decoder      = blocks.null_sink(gr.sizeof_gr_complex*1) # port 1 stays idle
+    if (FUSED_TX and DEBUG == False):
+      self.file_sink_reader       = blocks.file_sink(gr.sizeof_gr_complex*1, "../misc/data/reader", False)
+    else:
+      self.file_sink_reader       = blocks.file_sink(gr.sizeof_float*1,      "../misc/data/reader", False)
     self.file_sink_preamble = blocks.file_sink(gr.sizeof_gr_complex*1, "../misc/data/preamble", False)
     # self.file_sink_gate_pbr            = blocks.file_sink(gr.sizeof_gr_complex*1, "../misc/data/gate_pbr", False)
 
@@ -92,9 +110,16 @@ class reader_top_block(gr.top_block):
 
     ####### Blocks #########
     self.matched_filter = filter.fir_filter_ccc(self.decim,self.num_taps)
-    self.gate = rfid.gate(int(self.adc_rate/self.decim))
+    if (FUSED_MATCHED_FILTER and DEBUG == False):
+      self.gate = rfid.gate(int(self.adc_rate/self.decim), len(self.num_taps), self.decim)
+    else:
+      self.gate = rfid.gate(int(self.adc_rate/self.decim))
     self.tag_decoder    = rfid.tag_decoder(int(self.adc_rate/self.decim))
-    self.reader          = rfid.reader(int(self.adc_rate/self.decim),int(self.dac_rate))
+    self.tag_decoder.set_debug_tap_mode(DEBUG_TAP)
+    self.tag_decoder.set_debug_tap_interval(DEBUG_TAP_INTERVAL)
+    self.tag_decoder.set_debug_tap_encoding(DEBUG_TAP_ENCODING)
+    self.fused_tx = FUSED_TX and DEBUG == False
+    self.reader          = rfid.reader(int(self.adc_rate/self.decim),int(self.dac_rate),RATE_POLICY,self.fused_tx)
     self.amp              = blocks.multiply_const_ff(self.ampl)
     self.to_complex      = blocks.float_to_complex()
     self.rta_amp = rfid.multiply_rta_ff()
@@ -125,8 +150,11 @@ class reader_top_block(gr.top_block):
       # print(dir(rfid))
 
       ######## Connections #########
-      self.connect(self.source,  self.matched_filter)
-      self.connect(self.matched_filter, self.gate)
+      if FUSED_MATCHED_FILTER:
+        self.connect(self.source, self.gate)
+      else:
+        self.connect(self.source,  self.matched_filter)
+        self.connect(self.matched_filter, self.gate)
 
       # self.connect(self.source, self.gate_pbr)
       # self.connect(self.gate_pbr, self.feature_extractor_pbr)
@@ -156,9 +184,12 @@ class reader_top_block(gr.top_block):
       self.connect((self.tag_decoder,2), self.s2v)
       self.connect(self.s2v, self.fft1)
       self.connect(self.fft1, self.dnn_inference)
-      self.connect(self.reader, self.rta_amp)
-      self.connect(self.rta_amp, self.to_complex)
-      self.connect(self.to_complex, self.sink)
+      if self.fused_tx:
+        self.connect(self.reader, self.sink)
+      else:
+        self.connect(self.reader, self.rta_amp)
+        self.connect(self.rta_amp, self.to_complex)
+        self.connect(self.to_complex, self.sink)
 
       # self.msg_connect(self.reader, "reader_command", self.sink, "command")
       # self.connect(self.source, self.gate_probe)
@@ -186,7 +217,7 @@ class reader_top_block(gr.top_block):
     
     #File sinks for logging 
     self.connect(self.gate, self.file_sink_gate)
-    self.connect((self.tag_decoder,1), self.file_sink_decoder) # (Do not comment this line)
+    self.connect((self.tag_decoder,1), self.file_sink_decoder) # (Do not comment this line, ports must be contiguous)
     self.connect(self.reader, self.file_sink_reader)
     self.connect((self.tag_decoder,2), self.file_sink_preamble)
     # self.connect(self.gate_pbr, self.file_sink_gate_pbr)
@@ -0,0 +1,217 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+// Inventory throughput against tag population size.
+//
+// Slotted Gen2 inventory of N tags with the slot count selection of the
+// decoder (lib/q_algorithm.h): every unread tag draws a slot counter in
+// [0, 2^Q - 1] on Query and QueryAdjust and counts down on QueryRep; a slot
+// with one reply reads the tag, a collision sends the colliding tags back to
+// arbitrate until the next Query/QueryAdjust. Slot durations are those of
+// the reader (lib/link_profile.h): Tsk with a reply, Ti without.
+// The identification time of the whole population is reported for every
+// slot count selection mode (Q_SELECTION_MODE).
+
+#include "q_algorithm.h"
+#include "link_profile.h"
+#include "rfid/global_vars.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace gr::rfid;
+
+namespace {
+
+  struct bench_mode
+  {
+    const char * name;
+    int initial_q;
+    int mode;
+  };
+
+  struct inventory_result
+  {
+    long slots, idle, single, collision;
+    long queries, query_reps, query_adjusts;
+    int read;
+    double time_s;
+    double decision_ns;
+  };
+
+  inventory_result run_inventory(int n_tags, const bench_mode & mode, const link_profile & link,
+                                 float p_ok, long max_slots, unsigned seed)
+  {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> u(0, 1);
+    q_algorithm q(mode.initial_q, C, mode.mode, link.Ti / link.Tsk);
+
+    inventory_result res = {0, 0, 0, 0, 1, 0, 0, 0, 0, 0};
+    std::vector<int> counter(n_tags);
+    std::vector<int> unread(n_tags);
+    for (int k = 0; k < n_tags; k++)
+      unread[k] = k;
+
+    // Query / QueryAdjust: every unread tag draws its slot
+    auto draw_slots = [&]() {
+      std::uniform_int_distribution<int> slot(0, q.round_slots() - 1);
+      for (int k : unread)
+        counter[k] = slot(rng);
+    };
+    draw_slots();
+
+    double decision_ns = 0;
+    while (!unread.empty() && res.slots < max_slots)
+    {
+      int replies = 0, first = -1;
+      for (int k : unread)
+        if (counter[k] == 0)
+        {
+          replies++;
+          first = k;
+        }
+
+      slot_outcome outcome;
+      if (replies == 0)
+      {
+        outcome = SLOT_IDLE;
+        res.idle++;
+        res.time_s += link.Ti * 1e-6;
+      }
+      else if (replies == 1 && u(rng) < p_ok)
+      {
+        outcome = SLOT_SINGLE;
+        res.single++;
+        res.read++;
+        res.time_s += link.Tsk * 1e-6;
+        unread.erase(std::find(unread.begin(), unread.end(), first));
+      }
+      else
+      {
+        // the reader cannot tell a collision from a lost EPC
+        outcome = SLOT_COLLISION;
+        res.collision++;
+        res.time_s += link.Tsk * 1e-6;
+        for (int k : unread)
+          if (counter[k] == 0)
+            counter[k] = INT_MAX;
+      }
+      res.slots++;
+
+      auto t0 = std::chrono::steady_clock::now();
+      slot_command next = q.end_slot(outcome);
+      decision_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+
+      if (next == SLOT_CMD_QUERY_REP)
+      {
+        res.query_reps++;
+        for (int k : unread)
+          if (counter[k] != INT_MAX)
+            counter[k]--;
+      }
+      else
+      {
+        if (next == SLOT_CMD_QUERY)
+          res.queries++;
+        else
+          res.query_adjusts++;
+        draw_slots();
+      }
+    }
+    res.decision_ns = decision_ns / std::max(1L, res.slots);
+    return res;
+  }
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+  int trials = 20;
+  int M = 1;
+  float p_ok = 1.0;
+  long max_slots = 200000;
+  std::vector<int> populations = {1, 10, 20, 50, 100, 200, 500, 1000};
+
+  for (int i = 1; i < argc; i++)
+  {
+    std::string a = argv[i];
+    if (a == "-t" && i + 1 < argc)
+      trials = std::max(1, atoi(argv[++i]));
+    else if (a == "-m" && i + 1 < argc)
+      M = atoi(argv[++i]);
+    else if (a == "-p" && i + 1 < argc)
+      p_ok = atof(argv[++i]);
+    else if (a == "-n" && i + 1 < argc)
+      populations = {atoi(argv[++i])};
+    else
+    {
+      fprintf(stderr, "usage: %s [-t trials] [-m encoding 1/2/4/8] [-p EPC success probability] [-n tags]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  link_profile link;
+  link.init(M, 1.0);
+
+  const bench_mode modes[] = {
+    {"fixed Q=0",        0,         Q_SELECT_FIXED},
+    {"fixed Q=4",        4,         Q_SELECT_FIXED},
+    {"Qfp",              Q_INITIAL, Q_SELECT_QFP},
+    {"Schoute",          Q_INITIAL, Q_SELECT_SCHOUTE},
+    {"Vogt",             Q_INITIAL, Q_SELECT_VOGT},
+  };
+
+  printf("M%d, Tsk %.0f us, Ti %.0f us, EPC success %.2f, %d trials, at most %ld slots\n\n",
+         M, link.Tsk, link.Ti, p_ok, trials, max_slots);
+  printf("%6s  %-14s %10s %10s %10s %9s %9s %9s %9s %8s\n", "tags", "mode", "time(ms)", "reads/s", "read",
+         "slots/tag", "idle", "collision", "QAdjust", "ns/slot");
+  for (int n : populations)
+  {
+    for (const bench_mode & mode : modes)
+    {
+      double reads = 0, time_s = 0, slots = 0, idle = 0, collision = 0, adjusts = 0, ns = 0;
+      for (int t = 0; t < trials; t++)
+      {
+        inventory_result r = run_inventory(n, mode, link, p_ok, max_slots, 1000u * n + t);
+        reads += r.read;
+        time_s += r.time_s;
+        slots += r.slots;
+        idle += r.idle;
+        collision += r.collision;
+        adjusts += r.query_adjusts;
+        ns += r.decision_ns;
+      }
+      // identification time of the whole population, if it was read
+      char ident[16] = "-";
+      if (reads == (double) trials * n)
+        snprintf(ident, sizeof(ident), "%.1f", 1000 * time_s / trials);
+      printf("%6d  %-14s %10s %10.1f %9.1f%% %9.2f %9.1f %9.1f %9.1f %8.1f\n", n, mode.name, ident, reads / time_s,
+             100.0 * reads / (trials * n), slots / std::max(1.0, reads), idle / trials, collision / trials,
+             adjusts / trials, ns / trials);
+    }
+  }
+  return 0;
+}
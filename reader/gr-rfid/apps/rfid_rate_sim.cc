@@ -0,0 +1,495 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+// Trace-driven rate adaptation simulator.
+//
+// Replays per-slot outcome traces through the rate controllers of the
+// reader (lib/rate_controller.h) and reports goodput, BpJ and Tx energy
+// with the same formulas as reader::print_results (lib/run_metrics.h).
+// Every (policy, parameter set, trace) run is independent, so they are
+// spread over all cores.
+//
+// Trace format, one line per slot and encoding ('#' starts a comment):
+//
+//   slot encoding amplitude crc rssi noise power_up_delay [phase]
+//
+//   slot            slot number; lines with the same number describe the
+//                   same slot with different encodings (synthetic traces
+//                   give all four, recorded ones the encoding in use)
+//   encoding        1, 2, 4 or 8 (FM0, Miller-2/4/8)
+//   amplitude       amplitude scalar (rta_ampl / 0.7)
+//   crc             1: EPC ok, 0: CRC error / EPC lost, -1: no RN16
+//   rssi, noise     dB, as the decoder estimates them
+//   power_up_delay  s the tag was unpowered before the slot (0 if none)
+//   phase           rad, channel phase (MobiRate only)
+//
+// When the policy picks an encoding the trace has no line for in a slot,
+// the outcome is drawn from the outcome frequencies of that encoding over
+// the trace (or of the nearest recorded encoding).
+
+#include "rate_controller.h"
+#include "link_profile.h"
+#include "run_metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace gr::rfid;
+
+namespace {
+
+  const int NOT_RECORDED = -2;
+
+  struct slot_entry
+  {
+    int crc[NUM_RATES];       // per rate index, NOT_RECORDED if absent
+    float amplitude;
+    float rssi, noise;
+    float power_up_delay;
+    float phase;
+  };
+
+  struct trace
+  {
+    std::string name;
+    std::vector<slot_entry> slots;
+    // outcome frequencies per rate: no reply, CRC error, ok
+    double p_outcome[NUM_RATES][3];
+  };
+
+  struct sim_result
+  {
+    run_summary summary;
+    int queries;
+    int epc_ok, epc_lost;
+    int rate_queries[NUM_RATES];
+  };
+
+  struct sim_config
+  {
+    std::string policy;
+    rate_controller_params params;
+  };
+
+  void compute_outcome_frequencies(trace & tr)
+  {
+    int count[NUM_RATES][3] = {{0}};
+    for (const slot_entry & s : tr.slots)
+      for (int r = 0; r < NUM_RATES; r++)
+        if (s.crc[r] != NOT_RECORDED)
+          count[r][s.crc[r] + 1]++;
+
+    for (int r = 0; r < NUM_RATES; r++)
+    {
+      // nearest rate with data
+      int src = -1;
+      for (int d = 0; d < NUM_RATES && src < 0; d++)
+      {
+        if (r - d >= 0 && count[r - d][0] + count[r - d][1] + count[r - d][2] > 0)
+          src = r - d;
+        else if (r + d < NUM_RATES && count[r + d][0] + count[r + d][1] + count[r + d][2] > 0)
+          src = r + d;
+      }
+      int n = src < 0 ? 0 : count[src][0] + count[src][1] + count[src][2];
+      for (int k = 0; k < 3; k++)
+        tr.p_outcome[r][k] = n ? (double) count[src][k] / n : (k == 0);
+    }
+  }
+
+  bool load_trace(const std::string & path, trace & tr)
+  {
+    std::ifstream f(path);
+    if (!f)
+      return false;
+
+    tr.name = path;
+    tr.slots.clear();
+    std::string line;
+    int last_slot = -1;
+    while (std::getline(f, line))
+    {
+      size_t hash = line.find('#');
+      if (hash != std::string::npos)
+        line.resize(hash);
+      std::istringstream ss(line);
+      int slot, M, crc;
+      float amplitude, rssi, noise, delay, phase = 0;
+      if (!(ss >> slot >> M >> amplitude >> crc >> rssi >> noise >> delay))
+        continue;
+      ss >> phase;
+
+      if (slot != last_slot)
+      {
+        slot_entry s;
+        std::fill(s.crc, s.crc + NUM_RATES, NOT_RECORDED);
+        s.amplitude = amplitude;
+        s.rssi = rssi;
+        s.noise = noise;
+        s.power_up_delay = delay;
+        s.phase = phase;
+        tr.slots.push_back(s);
+        last_slot = slot;
+      }
+      tr.slots.back().crc[link_profile_index(M)] = std::max(-1, std::min(1, crc));
+    }
+    compute_outcome_frequencies(tr);
+    return !tr.slots.empty();
+  }
+
+  // Channel with a slowly varying RSSI, occasional power-up gaps and an
+  // EPC success probability per encoding that grows with the SNR (about
+  // 3 dB of margin per step of M).
+  void synthetic_trace(int index, int n_slots, unsigned seed, trace & tr)
+  {
+    std::mt19937 rng(seed + 7919u * index);
+    std::uniform_real_distribution<float> u(0, 1);
+    std::normal_distribution<float> step(0, 0.3);
+
+    tr.name = "synthetic-" + std::to_string(index);
+    tr.slots.resize(n_slots);
+    float rssi = -45 - 20 * u(rng);
+    float phase = 0;
+    const float noise = -70;
+    for (int k = 0; k < n_slots; k++)
+    {
+      rssi = std::max(-75.0f, std::min(-35.0f, rssi + step(rng)));
+      phase = std::remainder(phase + 0.05f * step(rng), 2 * (float) M_PI);
+
+      slot_entry & s = tr.slots[k];
+      s.amplitude = 0.15;
+      s.rssi = rssi;
+      s.noise = noise;
+      s.phase = phase;
+      s.power_up_delay = u(rng) < 0.01 ? 0.05 + 0.45 * u(rng) : 0;
+      const bool reply = u(rng) < 0.9;
+      const float x = u(rng);
+      for (int r = 0; r < NUM_RATES; r++)
+      {
+        float margin = (rssi - noise) + 3 * (NUM_RATES - 1 - r) - 18;
+        float p_ok = 1 / (1 + std::exp(-margin / 2));
+        s.crc[r] = reply ? (x < p_ok) : -1;
+      }
+    }
+    compute_outcome_frequencies(tr);
+  }
+
+  sim_result simulate(const trace & tr, const sim_config & cfg, const link_profile * links, unsigned seed,
+                      double t_start)
+  {
+    std::unique_ptr<rate_controller> controller = make_rate_controller(cfg.policy, NUM_RATES - 1, cfg.params);
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> u(0, 1);
+
+    sim_result res;
+    memset(&res, 0, sizeof(res));
+
+    int rate = NUM_RATES - 1;   // index_ES starts at FM0
+    double t = t_start;
+    double t_first = -1, t_last = 0, monitor_start = 0;
+    run_totals totals;
+    totals.goodput_pkt_cnt = 0;
+    totals.E_Tx = 1E-5;
+    totals.accumulative_d_monitor = 1E-5;
+    int i_window = 0;
+    bool window_loss = false;
+
+    for (const slot_entry & s : tr.slots)
+    {
+      const link_profile & link = links[rate];
+      t += s.power_up_delay;
+
+      int crc = s.crc[rate];
+      if (crc == NOT_RECORDED)
+      {
+        double x = u(rng);
+        crc = x < tr.p_outcome[rate][0] ? -1 : x < tr.p_outcome[rate][0] + tr.p_outcome[rate][1] ? 0 : 1;
+      }
+      const bool valid = crc >= 0;
+      const bool success = crc == 1;
+
+      // slot with a reply: Query, RN16, ACK, EPC; idle slot: Query, timeout
+      t += (valid ? link.Tsk : link.Ti) * 1e-6;
+      res.queries++;
+      res.rate_queries[rate]++;
+
+      if (valid)
+      {
+        // Tx energy, accumulated like the decoder does on every RN16
+        if (t_first < 0)
+        {
+          t_first = t;
+          monitor_start = t;
+        }
+        else
+        {
+          double d_monitor = t - monitor_start;
+          float amp_cal = tx_amplitude_calibrated(s.amplitude);
+          totals.E_Tx += d_monitor * amp_cal * amp_cal;
+          totals.accumulative_d_monitor += d_monitor;
+          if (d_monitor > 0.04)
+            monitor_start = t;
+        }
+        t_last = t;
+
+        // bulk windows of bulky_N EPCs
+        if (success)
+          res.epc_ok++;
+        else
+        {
+          res.epc_lost++;
+          window_loss = true;
+        }
+        if (i_window >= link.bulky_N - 1)
+        {
+          if (!window_loss)
+            totals.goodput_pkt_cnt += link.bulky_N;
+          i_window = 0;
+          window_loss = false;
+        }
+        else
+          i_window++;
+      }
+
+      rate_observation obs;
+      obs.t = t;
+      obs.rate = rate;
+      obs.valid = valid;
+      obs.success = success;
+      obs.rssi = s.rssi;
+      obs.phase = s.phase;
+      controller->on_slot_result(obs);
+      rate = controller->select_next(obs);
+      controller->clear_notes();
+    }
+
+    totals.total_time = t_first < 0 ? 0 : t_last - t_first;
+    res.summary = summarize_run(totals);
+    return res;
+  }
+
+  std::vector<float> parse_list(const char * arg)
+  {
+    std::vector<float> v;
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ','))
+      v.push_back(std::atof(item.c_str()));
+    return v;
+  }
+
+  void usage(const char * prog)
+  {
+    fprintf(stderr,
+      "usage: %s [options] [trace files...]\n"
+      "  -p NAME           policy: fixed, arf, minstrel, blink, mobirate (repeatable, default all)\n"
+      "  -j N              worker threads (default: all cores)\n"
+      "  -s N              add N synthetic traces\n"
+      "  -n SLOTS          slots per synthetic trace (default 20000)\n"
+      "  --seed S          random seed (default 1)\n"
+      "  --t0 S            time of the first slot in seconds (default 0), e.g. 1e6\n"
+      "                    to run the policies against a clock with an arbitrary epoch\n"
+      "  --th-rssi LIST    BLINK RSSI thresholds to sweep, e.g. 0.1,0.2,0.4\n"
+      "  --th-pktloss LIST BLINK packet loss thresholds to sweep\n"
+      "  --arf-up LIST     ARF successes before stepping up\n"
+      "  --arf-down LIST   ARF failures before stepping down\n"
+      "  -v                one line per trace\n", prog);
+  }
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+  std::vector<std::string> policies, files;
+  int n_threads = std::max(1u, std::thread::hardware_concurrency());
+  int n_synthetic = 0, n_slots = 20000;
+  unsigned seed = 1;
+  double t_start = 0;
+  bool verbose = false;
+  rate_controller_params defaults;
+  std::vector<float> th_rssi(1, defaults.blink_th_rssi), th_pktloss(1, defaults.blink_th_pktloss);
+  std::vector<float> arf_up(1, defaults.arf_up), arf_down(1, defaults.arf_down);
+
+  for (int i = 1; i < argc; i++)
+  {
+    std::string a = argv[i];
+    bool has_value = i + 1 < argc;
+    if (a == "-p" && has_value)
+      policies.push_back(argv[++i]);
+    else if (a == "-j" && has_value)
+      n_threads = std::max(1, atoi(argv[++i]));
+    else if (a == "-s" && has_value)
+      n_synthetic = atoi(argv[++i]);
+    else if (a == "-n" && has_value)
+      n_slots = atoi(argv[++i]);
+    else if (a == "--seed" && has_value)
+      seed = strtoul(argv[++i], NULL, 10);
+    else if (a == "--t0" && has_value)
+      t_start = atof(argv[++i]);
+    else if (a == "--th-rssi" && has_value)
+      th_rssi = parse_list(argv[++i]);
+    else if (a == "--th-pktloss" && has_value)
+      th_pktloss = parse_list(argv[++i]);
+    else if (a == "--arf-up" && has_value)
+      arf_up = parse_list(argv[++i]);
+    else if (a == "--arf-down" && has_value)
+      arf_down = parse_list(argv[++i]);
+    else if (a == "-v")
+      verbose = true;
+    else if (a[0] == '-')
+    {
+      usage(argv[0]);
+      return 1;
+    }
+    else
+      files.push_back(a);
+  }
+  if (policies.empty())
+    policies = {"fixed", "arf", "minstrel", "blink", "mobirate"};
+
+  // traces
+  std::vector<trace> traces(files.size() + n_synthetic);
+  for (size_t i = 0; i < files.size(); i++)
+  {
+    if (!load_trace(files[i], traces[i]))
+    {
+      fprintf(stderr, "cannot read trace %s\n", files[i].c_str());
+      return 1;
+    }
+  }
+  for (int i = 0; i < n_synthetic; i++)
+    synthetic_trace(i, n_slots, seed, traces[files.size() + i]);
+  if (traces.empty())
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  // configurations: every policy, with the parameter sweeps of that policy
+  std::vector<sim_config> configs;
+  for (const std::string & p : policies)
+  {
+    sim_config c;
+    c.policy = p;
+    if (!make_rate_controller(p, 0))
+    {
+      fprintf(stderr, "unknown policy %s\n", p.c_str());
+      return 1;
+    }
+    if (p == "blink")
+    {
+      for (float a : th_rssi)
+        for (float b : th_pktloss)
+        {
+          c.params.blink_th_rssi = a;
+          c.params.blink_th_pktloss = b;
+          configs.push_back(c);
+        }
+    }
+    else if (p == "arf")
+    {
+      for (float a : arf_up)
+        for (float b : arf_down)
+        {
+          c.params.arf_up = (int) a;
+          c.params.arf_down = (int) b;
+          configs.push_back(c);
+        }
+    }
+    else
+      configs.push_back(c);
+  }
+
+  // durations of every encoding (the sample rate only sizes the CW buffers)
+  link_profile links[NUM_RATES];
+  for (int r = 0; r < NUM_RATES; r++)
+    links[r].init(RATE_M[r], 1.0);
+
+  // all runs over all cores
+  const size_t n_runs = configs.size() * traces.size();
+  std::vector<sim_result> results(n_runs);
+  std::atomic<size_t> next(0);
+  auto t0 = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int w = 0; w < n_threads; w++)
+    workers.emplace_back([&]() {
+      for (size_t job = next++; job < n_runs; job = next++)
+      {
+        size_t c = job / traces.size(), k = job % traces.size();
+        results[job] = simulate(traces[k], configs[c], links, seed + (unsigned) job, t_start);
+      }
+    });
+  for (std::thread & w : workers)
+    w.join();
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  printf("%-10s %-22s %14s %14s %12s %10s %10s  %s\n", "policy", "params", "goodput(pkt/s)",
+         "BpJ(kbits/J)", "E_Tx(J)", "loss", "bulk(ms)", "queries M8/M4/M2/FM0");
+  for (size_t c = 0; c < configs.size(); c++)
+  {
+    const sim_config & cfg = configs[c];
+    char params[64] = "";
+    if (cfg.policy == "blink")
+      snprintf(params, sizeof(params), "th_rssi=%g th_loss=%g", cfg.params.blink_th_rssi, cfg.params.blink_th_pktloss);
+    else if (cfg.policy == "arf")
+      snprintf(params, sizeof(params), "up=%d down=%d", cfg.params.arf_up, cfg.params.arf_down);
+
+    double goodput = 0, bpj = 0, e_tx = 0, delay = 0;
+    int n_delay = 0;
+    long ok = 0, lost = 0, per_rate[NUM_RATES] = {0};
+    for (size_t k = 0; k < traces.size(); k++)
+    {
+      const sim_result & r = results[c * traces.size() + k];
+      goodput += r.summary.goodput_pkts;
+      bpj += r.summary.bpj;
+      e_tx += r.summary.E_Tx;
+      // no complete bulk window, no delay
+      if (r.summary.goodput_pkts > 0)
+      {
+        delay += r.summary.bulk_delay_ms;
+        n_delay++;
+      }
+      ok += r.epc_ok;
+      lost += r.epc_lost;
+      for (int q = 0; q < NUM_RATES; q++)
+        per_rate[q] += r.rate_queries[q];
+      if (verbose)
+        printf("  %-10s %-22s %-24s %14.2f %14.2f %12.4g\n", cfg.policy.c_str(), params, traces[k].name.c_str(),
+               r.summary.goodput_pkts, r.summary.bpj, r.summary.E_Tx);
+    }
+    double n = traces.size();
+    printf("%-10s %-22s %14.2f %14.2f %12.4g %10.4f %10.1f  %ld/%ld/%ld/%ld\n", cfg.policy.c_str(), params,
+           goodput / n, bpj / n, e_tx / n, lost / std::max(1.0, (double) (ok + lost)), n_delay ? delay / n_delay : NAN,
+           per_rate[0], per_rate[1], per_rate[2], per_rate[3]);
+  }
+  printf("\n%zu runs (%zu traces x %zu configurations) in %.3f s on %d threads, %.0f runs/s\n",
+         n_runs, traces.size(), configs.size(), elapsed, n_threads, n_runs / elapsed);
+  return 0;
+}
@@ -0,0 +1,114 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_BIT_BUFFER_H
+#define INCLUDED_RFID_BIT_BUFFER_H
+
+#include <stdint.h>
+
+namespace gr {
+  namespace rfid {
+
+    // Fixed-capacity packed bit string, first bit in the MSB of the first
+    // word (the order bits go on air). Used for decoded tag replies and
+    // reader commands; lives on the stack or inside READER_STATS, so no
+    // allocation on the RN16 -> ACK path.
+    class bit_buffer
+    {
+      public:
+        static const int MAX_BITS = 256;
+
+        bit_buffer() { clear(); }
+
+        void clear()
+        {
+          d_size = 0;
+          for (int w = 0; w < WORDS; w++)
+            d_words[w] = 0;
+        }
+
+        int size() const { return d_size; }
+
+        int operator[](int i) const
+        {
+          return (d_words[i >> 6] >> (63 - (i & 63))) & 1;
+        }
+
+        void push_back(int bit)
+        {
+          if (bit)
+            d_words[d_size >> 6] |= (uint64_t) 1 << (63 - (d_size & 63));
+          d_size++;
+        }
+
+        // Append the count (<= 64) low bits of value, most significant first
+        void append(uint64_t value, int count)
+        {
+          if (count == 0)
+            return;
+          value <<= 64 - count;
+          int offset = d_size & 63;
+          d_words[d_size >> 6] |= value >> offset;
+          if (offset + count > 64)
+            d_words[(d_size >> 6) + 1] |= value << (64 - offset);
+          d_size += count;
+        }
+
+        // Append bits given as 0/1 ints (the command tables of global_vars.h)
+        void append(const int * bits, int count)
+        {
+          for (int i = 0; i < count; i++)
+            push_back(bits[i]);
+        }
+
+        void append(const bit_buffer & src, int first, int count)
+        {
+          while (count > 0)
+          {
+            int n = count < 64 ? count : 64;
+            append(src.get(first, n), n);
+            first += n;
+            count -= n;
+          }
+        }
+
+        // count (<= 64) bits starting at first, first bit most significant
+        uint64_t get(int first, int count) const
+        {
+          if (count == 0)
+            return 0;
+          int offset = first & 63;
+          uint64_t v = d_words[first >> 6] << offset;
+          if (offset + count > 64)
+            v |= d_words[(first >> 6) + 1] >> (64 - offset);
+          return v >> (64 - count);
+        }
+
+      private:
+        static const int WORDS = MAX_BITS / 64;
+
+        uint64_t d_words[WORDS];
+        int d_size;
+    };
+
+  } // namespace rfid
+} // namespace gr
+
+#endif /* INCLUDED_RFID_BIT_BUFFER_H */
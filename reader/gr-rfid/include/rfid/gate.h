@@ -47,8 +47,14 @@ namespace gr {
        * constructor is in a private implementation
        * class. rfid::gate::make is the public interface for
        * creating new instances.
+       *
+       * \param sample_rate rate (samples/s) at which the gate works, i.e. after decimation
+       * \param mf_taps length of the half-bit matched filter (all-ones FIR) applied
+       *        before gating, 0 if the input is already filtered
+       * \param decim decimation of the matched filter output (input rate is
+       *        sample_rate * decim)
        */
-      static sptr make(int sample_rate);
+      static sptr make(int sample_rate, int mf_taps = 0, int decim = 1);
 
     };
 
@@ -22,7 +22,13 @@
 #define INCLUDED_RFID_GLOBAL_VARS_H
 
 #include <rfid/api.h>
+#include <rfid/bit_buffer.h>
+#include <rfid/tag_table.h>
+#include <gnuradio/gr_complex.h>
+#include <cmath>
+#include <ctime>
 #include <map>
+#include <vector>
 #include <sys/time.h>
 
 namespace gr {
@@ -79,10 +85,9 @@ namespace gr {
       int stop;
       
       std::vector<int>  unique_tags_round;
-      std::map<int,int> tag_reads;   
-      std::vector<float> RN16_bits_handle; 
-      std::vector<float> RN16_bits_read;
-      std::vector<gr_complex> aux_EPC_samples_complex;
+      tag_table tag_reads;          // tags read, by EPC
+      bit_buffer RN16_bits_handle;  // RN16 of the tag in the current access sequence
+      bit_buffer RN16_bits_read;    // handle returned by Req_RN16
       int aux_EPC_index;
 
       struct timeval start, end; 
@@ -100,10 +105,15 @@ namespace gr {
       int n_samples_to_ungate; // used by the GATE and DECODER block
     };
     
-    extern float RN16_handle_stored[16];
-
     extern READER_STATE * reader_state;
     extern void initialize_reader_state();
+    // Longest gated window (M8 EPC) in samples, used to preallocate buffers
+    extern int max_tag_reply_samples(int sample_rate);
+    // Decoder -> reader hand-off (EVENT_DRIVEN_EN): the decoder calls
+    // notify_reader_state() once it has decided the next command, the reader
+    // sleeps in wait_reader_state() while IDLE. Returns false on timeout.
+    extern void notify_reader_state();
+    extern bool wait_reader_state(int timeout_ms);
 
     // CONSTANTS (READER CONFIGURATION)
 
@@ -111,6 +121,15 @@ namespace gr {
     const int FIXED_Q = 0;
     const float C = 0.2;
 
+    // Slot count of the inventory rounds (see q_algorithm.h): Q_SELECT_FIXED =
+    // rounds of 2^FIXED_Q slots, a CRC-valid EPC is ACKed again (bulk reading
+    // of one tag); otherwise Q starts from Q_INITIAL and is chosen by the Gen2
+    // Q-algorithm (Qfp) or by a tag population estimate at the end of each
+    // round (Schoute, Vogt), and a CRC-valid EPC ends the slot
+    enum Q_SELECTION_MODE   {Q_SELECT_FIXED, Q_SELECT_QFP, Q_SELECT_SCHOUTE, Q_SELECT_VOGT};
+    const int Q_SELECTION = Q_SELECT_FIXED;
+    const int Q_INITIAL = 4;
+
     // Termination criteria
     
     const int MAX_NUM_QUERIES     = 29000;     //(11000)3000+3000+3000+3000+3000 Stop after MAX_NUM_QUERIES have been sent
@@ -196,17 +215,17 @@ namespace gr {
     const int Q_UPDN[7][3]  = { {0,0,0}, {0,0,1}, {0,1,0}, {0,1,1}, {1,0,0}, {1,0,1}, {1,1,0}};
 
     // Encoding preamble sequences
-    const int TAG_PREAMBLE_FM0[] = {1,1,0,1,0,0,1,0,0,0,1,1};
-    const int TAG_PREAMBLE_M2[] = {
+    constexpr int TAG_PREAMBLE_FM0[] = {1,1,0,1,0,0,1,0,0,0,1,1};
+    constexpr int TAG_PREAMBLE_M2[] = {
       1,0,1,0, 1,0,0,1, 0,1,0,1, 0,1,1,0, 1,0,0,1, 0,1,1,0};
-    const int TAG_PREAMBLE_M4[] = {
+    constexpr int TAG_PREAMBLE_M4[] = {
       1,0,1,0,1,0,1,0, 1,0,1,0,0,1,0,1, 0,1,0,1,0,1,0,1, 0,1,0,1,1,0,1,0, 1,0,1,0,0,1,0,1, 0,1,0,1,1,0,1,0};
-    const int TAG_PREAMBLE_M8[] = {1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,
-                                   1,0,1,0,1,0,1,0,0,1,0,1,0,1,0,1,
-                                   0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,
-                                   0,1,0,1,0,1,0,1,1,0,1,0,1,0,1,0,
-                                   1,0,1,0,1,0,1,0,0,1,0,1,0,1,0,1,
-                                   0,1,0,1,0,1,0,1,1,0,1,0,1,0,1,0};
+    constexpr int TAG_PREAMBLE_M8[] = {1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,
+                                       1,0,1,0,1,0,1,0,0,1,0,1,0,1,0,1,
+                                       0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,
+                                       0,1,0,1,0,1,0,1,1,0,1,0,1,0,1,0,
+                                       1,0,1,0,1,0,1,0,0,1,0,1,0,1,0,1,
+                                       0,1,0,1,0,1,0,1,1,0,1,0,1,0,1,0};
 
     const int M2_DATA_ONE[] = {1,0,0,1};
     const int M2_DATA_ONE_1[] = {0,1,1,0};
@@ -230,15 +249,55 @@ namespace gr {
     const int M4_ONE_LEN = 8;
     const int M8_ONE_LEN = 16;
 
-    const int FM0_PREAMBLE_LEN = 12;
-    const int M2_PREAMBLE_LEN = 24;
-    const int M4_PREAMBLE_LEN = 48;
-    const int M8_PREAMBLE_LEN = 96;
-
-    const int FM0_PREAMBLE_POWER = 6;
-    const int M2_PREAMBLE_POWER = 12;
-    const int M4_PREAMBLE_POWER = 24;
-    const int M8_PREAMBLE_POWER = 48;
+    constexpr int FM0_PREAMBLE_LEN = 12;
+    constexpr int M2_PREAMBLE_LEN = 24;
+    constexpr int M4_PREAMBLE_LEN = 48;
+    constexpr int M8_PREAMBLE_LEN = 96;
+
+    constexpr int FM0_PREAMBLE_POWER = 6;
+    constexpr int M2_PREAMBLE_POWER = 12;
+    constexpr int M4_PREAMBLE_POWER = 24;
+    constexpr int M8_PREAMBLE_POWER = 48;
+
+    // Preamble search in tag_sync: 0 = SIMD kernel (bit-identical to the scalar
+    // search), 1 = sliding-window prefix-sum correlator (O(window + taps))
+    const int SYNC_INCREMENTAL_EN = 0;
+
+    // Half-bit period estimation (see period_estimator.h)
+    // (coarse-to-fine and spectral are faster but not yet validated on
+    // recorded captures; the exhaustive search stays the default)
+    enum T_ESTIMATOR_MODE   {T_EST_EXHAUSTIVE, T_EST_COARSE_TO_FINE, T_EST_SPECTRAL};
+    const int T_ESTIMATOR = T_EST_EXHAUSTIVE;
+    // Also run the exhaustive search, keep its result and report disagreements
+    const int T_EST_CROSSCHECK_EN = 0;
+
+    // Per-tag clock cache (see tag_clock_cache.h): verify the previous T of
+    // the tag (slot, then known EPCs) before running the full estimation.
+    // Off until its hit path is validated against T_ESTIMATOR on captures
+    const int TAG_CACHE_EN = 0;
+    const int TAG_CACHE_CFO_EN = 0;         // also reuse the cached alpha_CFO on a hit
+    const float TAG_CACHE_T_TOL = 0.01;     // largest change of T accepted on a hit (samples)
+    const float TAG_CACHE_EMA = 0.25;       // weight of a new EPC in the per-tag average
+    const int TAG_CACHE_CANDIDATES = 4;     // entries verified before falling back
+
+    // DC offset removal of the gate while open (see dc_removal_kernel.h):
+    // scale by 1 - |dc|/|in| (sqrt and divide per sample), the same with a
+    // reciprocal square root estimate, or subtract the complex DC estimate
+    enum DC_REMOVAL_MODE    {DC_REMOVAL_SCALE, DC_REMOVAL_RSQRT, DC_REMOVAL_SUBTRACT};
+    const int DC_REMOVAL = DC_REMOVAL_RSQRT;
+
+    // Hot-path logging (see async_log.h): records are queued on the block
+    // threads and printed by a background thread every ASYNC_LOG_DRAIN_MS
+    const int ASYNC_LOG_EN = 1;
+    const int ASYNC_LOG_DRAIN_MS = 20;
+    const int LOG_DEBUG_EN = 0;             // also print the reader state trace
+
+    // Scheduling of the blocks: the decoder is only called with a full gated
+    // reply (forecast), the reader sleeps while IDLE until the decoder's
+    // verdict (or READER_IDLE_WAIT_MS, so the flowgraph can stop). 0 = the
+    // reader and decoder are called in a loop and poll reader_state.
+    const int EVENT_DRIVEN_EN = 1;
+    const int READER_IDLE_WAIT_MS = 5;
     
     //ACCESS COMMANDS
     const int REQ_RN16_CODE[8] = {1,1,0,0,0,0,0,1};
@@ -263,61 +322,22 @@ namespace gr {
     
     // Encoding Scheme Index List
     const int index_ES_LIST[] = {8, 4, 2, 1};
+    const int MAX_ENCODING_SCHEME = 8; // slowest entry, sizes the preallocated buffers
     const int Retran_Winsize[4] = {1, 1, 2, 3};
-    // Fixed Encoding Scheme params
-    const int FIXED_RATE_EN = 1;
 
-    // Minstrel params
+    // Rate adaptation policies (lib/rate_controller.h) are selected by the
+    // rate_policy argument of reader::make; these flags give the default
+    const int FIXED_RATE_EN = 1;
     const int MINSTREL_EN = 0;
-    extern clock_t minstrel_timer;
-    extern float pktloss_table[4];
-    extern int PROBING_MODE;
-    extern int probing_rate_cnt; // rate index
-    extern int probing_cnt; // count of single rate
-    extern int n_success;
-    extern clock_t dwelling_clk_start;
-    
-    // Auto Rate Fallback params
     const int AUTO_RATE_FALLBACK_EN = 0;
+    const int BLINK_EN = 0;
+    const int MobiRate_EN = 0;
+
+    // rate of the current Query, and the outcome of its slot (set by the decoder)
     extern int index_ES;
-    extern int prev_transmission_state;
     extern int curr_transmission_state;
-    extern int n_consecutive_success;
-    extern int n_consecutive_failure;
-    extern int just_elevated;
     extern int valid_packet;
     
-    // BLINK params
-    const int BLINK_EN = 0;
-    const float Th_RSSI = 0.20;
-    const float Th_pktloss = 0.15;
-    extern int BLINK_MODE; // (0: KEEP, 1: PROBING)
-    extern int blink_scan_start;
-    extern int blink_scan_cnt;
-    extern clock_t blink_timer;
-    extern float blink_n_success;
-    extern float blink_n_failure;
-    extern float blink_pktloss_realtime;
-    extern float blink_pktloss_firstscan;
-    extern float blink_pktloss_secondscan;
-    extern float blink_RSSI_firstscan;
-    extern float blink_RSSI_secondscan;
-    extern float blink_pktloss_probe;
-    extern float blink_RSSI_probe;
-    
-    // MobiRate params
-    const int MobiRate_EN = 0;
-    extern float lambda; // exponential coefficient
-    extern int MobiRate_MODE; // (0: KEEP, 1: HIGHER, 2: LOWER) 
-    extern clock_t mobirate_timer1;
-    extern clock_t mobirate_timer2;
-    extern float mobirate_phase_realtime;
-    extern int mobirate_phase_scan_cnt;
-    extern int mobirate_n_failure;
-    extern float mobirate_pktloss_table[4];
-    const float PI = 3.14159;  
-    const float WAVLEN = 30000.0 / (915 * 4 * PI); 
-    
     // Signal params
     extern float sig_power;
     extern float RSSI;
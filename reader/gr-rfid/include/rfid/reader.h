@@ -23,6 +23,7 @@
 
 #include <rfid/api.h>
 #include <gnuradio/block.h>
+#include <string>
 
 namespace gr {
   namespace rfid {
@@ -47,8 +48,16 @@ namespace gr {
        * constructor is in a private implementation
        * class. rfid::reader::make is the public interface for
        * creating new instances.
+       *
+       * \param rate_policy rate adaptation policy: "fixed", "arf",
+       *        "minstrel", "blink", "mobirate" or "adabs". Empty selects
+       *        the one enabled in global_vars.h.
+       * \param complex_output emit gr_complex samples already scaled by
+       *        rta_ampl (replaces multiply_rta_ff + float_to_complex)
+       *        instead of unscaled floats.
        */
-      static sptr make(int sample_rate, int dac_rate);
+      static sptr make(int sample_rate, int dac_rate, const std::string & rate_policy = "",
+                       bool complex_output = false);
 
     };
 
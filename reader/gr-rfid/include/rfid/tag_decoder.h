@@ -27,6 +27,14 @@
 namespace gr {
   namespace rfid {
 
+    //! What the decoder copies to its debug output (port 1)
+    enum debug_tap_mode {
+      DEBUG_TAP_OFF = 0,        //!< nothing, the port is never written (default)
+      DEBUG_TAP_EVERY_NTH,      //!< every Nth decoded packet, see set_debug_tap_interval()
+      DEBUG_TAP_FAILED_CRC,     //!< only packets whose CRC check failed (EPC, Handle)
+      DEBUG_TAP_ENCODING        //!< only packets of one encoding, see set_debug_tap_encoding()
+    };
+
     /*!
      * \brief <+description of block+>
      * \ingroup rfid
@@ -46,6 +54,15 @@ namespace gr {
        * creating new instances.
        */
       static sptr make(int sample_rate);
+
+      /*!
+       * \brief Select the packets copied to output 1, one of debug_tap_mode.
+       * Each tapped packet is the decoder input window followed by a
+       * single sample of value 2 as separator.
+       */
+      virtual void set_debug_tap_mode(int mode) = 0;
+      virtual void set_debug_tap_interval(int n) = 0;
+      virtual void set_debug_tap_encoding(int M) = 0;
     };
 
   } // namespace rfid
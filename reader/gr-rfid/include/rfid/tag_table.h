@@ -0,0 +1,137 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_RFID_TAG_TABLE_H
+#define INCLUDED_RFID_TAG_TABLE_H
+
+#include <rfid/bit_buffer.h>
+#include <stdint.h>
+
+namespace gr {
+  namespace rfid {
+
+    // Hash of a 96-bit EPC for the open-addressing tables keyed by it (this
+    // one and tag_clock_cache): 64-bit finalizer of MurmurHash3 over both halves
+    inline uint64_t epc_hash(uint64_t epc_hi, uint32_t epc_lo)
+    {
+      uint64_t h = epc_hi ^ ((uint64_t) epc_lo * 0x9e3779b97f4a7c15ULL);
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 33;
+      h *= 0xc4ceb9fe1a85ec53ULL;
+      h ^= h >> 33;
+      return h;
+    }
+
+    // Read accounting of one tag
+    struct tag_entry
+    {
+      uint64_t epc_hi;      // EPC bits 0..63
+      uint32_t epc_lo;      // EPC bits 64..95
+      int reads;            // 0: free slot
+      float rssi;           // dB, of the last read
+      float phase;          // rad, of the last read
+      double last_seen;     // s, CLOCK_MONOTONIC
+    };
+
+    // Fixed-capacity open-addressing table of the tags read, keyed by the
+    // 96-bit EPC. Linear probing over a power-of-two array filled at most to
+    // MAX_TAGS, so a lookup touches one or two cache lines; entries are never
+    // removed and nothing is allocated after construction. Lives inside
+    // READER_STATS, updated by the decoder on every CRC-valid EPC.
+    class tag_table
+    {
+      public:
+        static const int CAPACITY = 2048;
+        static const int MAX_TAGS = CAPACITY * 3 / 4;
+
+        tag_table() { clear(); }
+
+        void clear()
+        {
+          for (int i = 0; i < CAPACITY; i++)
+            d_entries[i].reads = 0;
+          d_size = 0;
+          d_dropped = 0;
+        }
+
+        // One read of the EPC in bits [first, first + 96). Returns the entry
+        // of the tag, NULL if it is new and the table is full.
+        tag_entry * update(const bit_buffer & bits, int first, float rssi, float phase, double t)
+        {
+          return update(bits.get(first, 64), (uint32_t) bits.get(first + 64, 32), rssi, phase, t);
+        }
+
+        tag_entry * update(uint64_t epc_hi, uint32_t epc_lo, float rssi, float phase, double t)
+        {
+          int i = probe(epc_hi, epc_lo);
+          tag_entry & e = d_entries[i];
+          if (e.reads == 0)
+          {
+            if (d_size >= MAX_TAGS)
+            {
+              d_dropped++;
+              return 0;
+            }
+            e.epc_hi = epc_hi;
+            e.epc_lo = epc_lo;
+            d_size++;
+          }
+          e.reads++;
+          e.rssi = rssi;
+          e.phase = phase;
+          e.last_seen = t;
+          return &e;
+        }
+
+        const tag_entry * find(uint64_t epc_hi, uint32_t epc_lo) const
+        {
+          const tag_entry & e = d_entries[probe(epc_hi, epc_lo)];
+          return e.reads ? &e : 0;
+        }
+
+        // number of tags read
+        int size() const { return d_size; }
+        // reads of new tags not stored because the table was full
+        unsigned long dropped() const { return d_dropped; }
+
+        // iteration over the slots, free ones have reads == 0
+        const tag_entry & slot(int i) const { return d_entries[i]; }
+
+      private:
+        tag_entry d_entries[CAPACITY];
+        int d_size;
+        unsigned long d_dropped;
+
+        // slot holding the EPC, or the free slot ending its probe sequence
+        int probe(uint64_t epc_hi, uint32_t epc_lo) const
+        {
+          int i = (int) (epc_hash(epc_hi, epc_lo) & (CAPACITY - 1));
+          while (d_entries[i].reads && (d_entries[i].epc_hi != epc_hi || d_entries[i].epc_lo != epc_lo))
+            i = (i + 1) & (CAPACITY - 1);
+          return i;
+        }
+    };
+
+  } // namespace rfid
+} // namespace gr
+
+#endif /* INCLUDED_RFID_TAG_TABLE_H */
@@ -0,0 +1,81 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "adabs_rate_controller.h"
+#include "rfid/global_vars.h"
+
+namespace gr {
+  namespace rfid {
+
+    adabs_rate_controller::adabs_rate_controller(int initial_rate)
+      : d_rate(initial_rate)
+    {
+    }
+
+    int adabs_rate_controller::select_next(const rate_observation &)
+    {
+      if (THROUGHPUT_MONITOR_EN == 1 && THROUGHPUT_AVAILABLE == 1) {
+        //float goodput_monitored = pow(pktCorrectRatio, bulky_N - 1) * tp_now;
+        goodput_monitored = throughput_monitored;
+        cnt_loss_epc = 0;
+        cnt_tp_monitored = 0;
+        throughput_monitored = 0;
+        add_note("tp monitored : ", goodput_monitored);
+        if (goodput_monitored < TP_LOWER_LIMIT || goodput_monitored > TP_UPPER_LIMIT) {
+          // prepare for probing
+          ADABS_PROBING_MODE = 1;
+          // FM0 & AMP = 1 for probing
+          d_rate = NUM_RATES - 1;
+          rta_ampl = 0.7 * 1;
+
+          THROUGHPUT_MONITOR_EN = 0; // when to enable?
+          THROUGHPUT_AVAILABLE = 0;
+          ADABS_PROBING_DONE = 0;
+          RSSI = 1E-10;
+          NoiseI = 1E-10;
+          cnt_NoiseI = 1;
+          cnt_RSSI = 1;
+          add_note("\n---start probing---");
+        }
+      }
+      if (ADABS_PROBING_MODE == 1 && ADABS_PROBING_DONE == 1) { // (powerup-delay is ready)
+        // call DNN
+        adabs_nn_en = 1; // it should be set 0 by dnn after inference
+      }
+      if (INFERENCE_RESULTS_AVAILABLE == 1) { // DNN inference is done
+        // adjust transmission parameters
+        rta_ampl = 0.7 * amp_inference;
+        d_rate = NUM_RATES - 1 - es_inference;
+
+        if (ADABS_PROBING_DONE == 1) { // if next power-up delay is available, tp monitor will be enabled again
+          INFERENCE_RESULTS_AVAILABLE = 0;
+          THROUGHPUT_MONITOR_EN = 1;
+        }
+      }
+      return d_rate;
+    }
+
+  } /* namespace rfid */
+} /* namespace gr */
@@ -0,0 +1,52 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_RFID_ADABS_RATE_CONTROLLER_H
+#define INCLUDED_RFID_ADABS_RATE_CONTROLLER_H
+
+#include "rate_controller.h"
+
+namespace gr {
+  namespace rfid {
+
+    // ADABS: a throughput monitor in the decoder triggers a probing phase
+    // (FM0, full amplitude); the DNN block then infers the encoding and the
+    // transmit amplitude. The handshake with the decoder and the DNN block
+    // goes through the flags of global_vars.h, so unlike the other
+    // controllers this one only runs inside the flowgraph. It also sets
+    // rta_ampl.
+    class adabs_rate_controller : public rate_controller
+    {
+      public:
+        adabs_rate_controller(int initial_rate);
+
+        const char * name() const { return "adabs"; }
+        void on_slot_result(const rate_observation &) {}
+        int select_next(const rate_observation & obs);
+
+      private:
+        int d_rate;
+    };
+
+  } // namespace rfid
+} // namespace gr
+
+#endif /* INCLUDED_RFID_ADABS_RATE_CONTROLLER_H */
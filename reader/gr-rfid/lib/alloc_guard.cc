@@ -0,0 +1,92 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "alloc_guard.h"
+
+#ifdef RFID_ALLOC_DEBUG
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static thread_local unsigned long alloc_count = 0;
+
+void * operator new(std::size_t size)
+{
+  alloc_count++;
+  void * p = std::malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void * operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void * p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void * p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void * p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void * p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+namespace gr {
+  namespace rfid {
+
+    unsigned long thread_alloc_count()
+    {
+      return alloc_count;
+    }
+
+    alloc_guard::alloc_guard(const char * name)
+      : d_name(name), d_start(alloc_count)
+    {
+    }
+
+    alloc_guard::~alloc_guard()
+    {
+      unsigned long n = alloc_count - d_start;
+      if (n)
+        fprintf(stderr, "[alloc_guard] %s: %lu heap allocations\n", d_name, n);
+    }
+
+  } /* namespace rfid */
+} /* namespace gr */
+
+#endif /* RFID_ALLOC_DEBUG */
@@ -0,0 +1,65 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_ALLOC_GUARD_H
+#define INCLUDED_RFID_ALLOC_GUARD_H
+
+// Debug check that the work() functions do not touch the heap. Built with
+// -DENABLE_ALLOC_DEBUG=ON, operator new is replaced by a counting version and
+// RFID_NO_ALLOC_SCOPE(name) reports every call of the enclosing scope that
+// allocated. Otherwise the macro expands to nothing.
+//
+// Used in the gate, decoder and reader work functions. It reports instead of
+// asserting: a few one-off allocations are expected there (the end-of-run
+// report, a Query variant rendered on first use), a report on every call is
+// the regression to look for. dnn_inference::work is not checked, TensorFlow
+// allocates its input and output tensors on each run.
+
+#ifdef RFID_ALLOC_DEBUG
+
+namespace gr {
+  namespace rfid {
+
+    // Heap allocations made by the calling thread so far
+    unsigned long thread_alloc_count();
+
+    class alloc_guard
+    {
+      public:
+        alloc_guard(const char * name);
+        ~alloc_guard();
+
+      private:
+        const char * d_name;
+        unsigned long d_start;
+    };
+
+  } // namespace rfid
+} // namespace gr
+
+#define RFID_NO_ALLOC_SCOPE(name) gr::rfid::alloc_guard rfid_alloc_guard_(name)
+
+#else
+
+#define RFID_NO_ALLOC_SCOPE(name)
+
+#endif /* RFID_ALLOC_DEBUG */
+
+#endif /* INCLUDED_RFID_ALLOC_GUARD_H */
@@ -0,0 +1,228 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "async_log.h"
+#include "rfid/global_vars.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+namespace gr {
+  namespace rfid {
+
+    // Single-producer single-consumer ring, one per logging thread
+    class log_ring
+    {
+      public:
+        static const unsigned SIZE = 1024;   // power of two
+
+        log_ring() : d_head(0), d_tail(0), d_dropped(0) {}
+
+        // producer side
+        void push(const log_record & r)
+        {
+          unsigned head = d_head.load(std::memory_order_relaxed);
+          if (head - d_tail.load(std::memory_order_acquire) == SIZE)
+          {
+            d_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+          }
+          d_buf[head & (SIZE - 1)] = r;
+          d_head.store(head + 1, std::memory_order_release);
+        }
+
+        // consumer side
+        void pop_all(std::vector<log_record> & out)
+        {
+          unsigned tail = d_tail.load(std::memory_order_relaxed);
+          unsigned head = d_head.load(std::memory_order_acquire);
+          for (; tail != head; tail++)
+            out.push_back(d_buf[tail & (SIZE - 1)]);
+          d_tail.store(tail, std::memory_order_release);
+        }
+
+        unsigned long take_dropped() { return d_dropped.exchange(0, std::memory_order_relaxed); }
+
+      private:
+        log_record d_buf[SIZE];
+        std::atomic<unsigned> d_head;
+        std::atomic<unsigned> d_tail;
+        std::atomic<unsigned long> d_dropped;
+    };
+
+    static void format_record(const log_record & r)
+    {
+      switch (r.event)
+      {
+        case LOG_NOTE:
+        case LOG_DEBUG_NOTE:
+          printf("%s\n", r.text);
+          break;
+        case LOG_VALUE:
+          printf("%s%g\n", r.text, r.arg[0]);
+          break;
+        case LOG_EPC:
+          printf("EPC: %x\n", (unsigned) (int64_t) r.arg[0]);
+          break;
+        case LOG_EPC_BIT_ERROR:
+          printf("%d : bit-error\n", (int) r.arg[0]);
+          break;
+        case LOG_EPC_NOT_FOUND:
+          printf("%d : no epc pkt found\n", (int) r.arg[0]);
+          break;
+        case LOG_T_MISMATCH:
+          printf("| T estimate mismatch: %g exhaustive %g\n", r.arg[0], r.arg[1]);
+          break;
+        case LOG_DEBUG_SLOT:
+          printf("INVENTORY ROUND : %d SLOT NUMBER : %d\n", (int) r.arg[0], (int) r.arg[1]);
+          break;
+      }
+    }
+
+    // Owns the rings and the thread that drains them
+    class async_logger
+    {
+      public:
+        async_logger() : d_stop(false)
+        {
+          if (ASYNC_LOG_EN)
+            d_thread = std::thread(&async_logger::run, this);
+        }
+
+        ~async_logger()
+        {
+          {
+            std::lock_guard<std::mutex> lock(d_mutex);
+            d_stop = true;
+          }
+          d_wake.notify_one();
+          if (d_thread.joinable())
+            d_thread.join();
+          drain();
+        }
+
+        log_ring * ring()
+        {
+          thread_local log_ring * r = 0;
+          if (!r)
+          {
+            std::lock_guard<std::mutex> lock(d_mutex);
+            d_rings.emplace_back(new log_ring);
+            r = d_rings.back().get();
+          }
+          return r;
+        }
+
+        // Print the queued records of all threads in time order
+        void drain()
+        {
+          std::lock_guard<std::mutex> lock(d_drain_mutex);
+          unsigned long dropped = 0;
+          {
+            std::lock_guard<std::mutex> lock(d_mutex);
+            for (size_t k = 0; k < d_rings.size(); k++)
+            {
+              d_rings[k]->pop_all(d_pending);
+              dropped += d_rings[k]->take_dropped();
+            }
+          }
+          if (d_pending.empty() && !dropped)
+            return;
+
+          std::stable_sort(d_pending.begin(), d_pending.end(),
+                           [](const log_record & a, const log_record & b) { return a.t_ns < b.t_ns; });
+          for (size_t k = 0; k < d_pending.size(); k++)
+            format_record(d_pending[k]);
+          if (dropped)
+            printf("| log: %lu records dropped\n", dropped);
+          fflush(stdout);
+          d_pending.clear();
+        }
+
+      private:
+        void run()
+        {
+          std::unique_lock<std::mutex> lock(d_mutex);
+          while (!d_stop)
+          {
+            d_wake.wait_for(lock, std::chrono::milliseconds(ASYNC_LOG_DRAIN_MS));
+            lock.unlock();
+            drain();
+            lock.lock();
+          }
+        }
+
+        std::mutex d_mutex;          // ring list and stop flag
+        std::mutex d_drain_mutex;    // one consumer at a time
+        std::condition_variable d_wake;
+        bool d_stop;
+        std::vector<std::unique_ptr<log_ring> > d_rings;
+        std::vector<log_record> d_pending;
+        std::thread d_thread;
+    };
+
+    static async_logger & logger()
+    {
+      static async_logger instance;
+      return instance;
+    }
+
+    void log_text(int event, const char * text, double a0, double a1, double a2)
+    {
+      if (!LOG_DEBUG_EN && (event == LOG_DEBUG_NOTE || event == LOG_DEBUG_SLOT))
+        return;
+
+      struct timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      log_record r;
+      r.t_ns = (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec;
+      r.event = event;
+      r.text = text;
+      r.arg[0] = a0;
+      r.arg[1] = a1;
+      r.arg[2] = a2;
+
+      if (!ASYNC_LOG_EN)
+      {
+        format_record(r);
+        return;
+      }
+      logger().ring()->push(r);
+    }
+
+    void log_flush()
+    {
+      if (ASYNC_LOG_EN)
+        logger().drain();
+    }
+
+  } /* namespace rfid */
+} /* namespace gr */
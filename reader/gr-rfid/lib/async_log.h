@@ -0,0 +1,71 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_ASYNC_LOG_H
+#define INCLUDED_RFID_ASYNC_LOG_H
+
+#include <stdint.h>
+
+namespace gr {
+  namespace rfid {
+
+    // Events of the hot paths. A record is fixed-size (timestamp, event,
+    // static text, 3 numeric arguments); the text is only formatted by the
+    // background thread, see format_record() in async_log.cc.
+    enum LOG_EVENT
+    {
+      LOG_NOTE,             // text
+      LOG_VALUE,            // text, value (printed like cout)
+      LOG_EPC,              // EPC
+      LOG_EPC_BIT_ERROR,    // number of queries sent
+      LOG_EPC_NOT_FOUND,    // number of queries sent
+      LOG_T_MISMATCH,       // T, T of the exhaustive search
+      LOG_DEBUG_NOTE,       // text (reader state trace, only with LOG_DEBUG_EN)
+      LOG_DEBUG_SLOT        // inventory round, slot number (only with LOG_DEBUG_EN)
+    };
+
+    struct log_record
+    {
+      uint64_t t_ns;        // CLOCK_MONOTONIC
+      int event;
+      const char * text;    // string literal, never copied
+      double arg[3];
+    };
+
+    // Queue a record on the ring of the calling thread (lock-free, no
+    // allocation after the first call of a thread). Records are dropped and
+    // counted if the ring is full.
+    void log_text(int event, const char * text, double a0 = 0, double a1 = 0, double a2 = 0);
+
+    inline void log_event(int event, double a0 = 0, double a1 = 0, double a2 = 0)
+    {
+      log_text(event, "", a0, a1, a2);
+    }
+
+    inline void log_note(const char * text) { log_text(LOG_NOTE, text); }
+    inline void log_value(const char * text, double value) { log_text(LOG_VALUE, text, value); }
+
+    // Print everything queued so far (before writing reports with cout)
+    void log_flush();
+
+  } // namespace rfid
+} // namespace gr
+
+#endif /* INCLUDED_RFID_ASYNC_LOG_H */
@@ -0,0 +1,131 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "command_waveforms.h"
+#include "gen2_crc.h"
+#include "async_log.h"
+#include <cassert>
+#include <cstring>
+
+namespace gr {
+  namespace rfid {
+
+    command_waveforms::command_waveforms()
+      : d_query(QUERY_SLOTS), d_query_count(0)
+    {
+      for (int s = 0; s < QUERY_SLOTS; s++)
+        d_query[s].used = false;
+    }
+
+    void command_waveforms::init(const std::vector<float> & data_0,
+                                 const std::vector<float> & data_1,
+                                 const std::vector<float> & query_preamble)
+    {
+      d_data_0 = data_0;
+      d_data_1 = data_1;
+      d_query_preamble = query_preamble;
+      for (int v = 0; v < 16; v++)
+      {
+        bit_buffer bits;
+        bits.append((uint64_t) v, 4);
+        d_nibble[v].clear();
+        append(d_nibble[v], bits);
+      }
+      for (int s = 0; s < QUERY_SLOTS; s++)
+        d_query[s].used = false;
+      d_query_count = 0;
+    }
+
+    int command_waveforms::render(float * out, const bit_buffer & bits, int first, int count) const
+    {
+      int written = 0;
+      const int end = first + count;
+      int i = first;
+      for (; i + 4 <= end; i += 4)
+      {
+        const std::vector<float> & symbols = d_nibble[bits.get(i, 4)];
+        memcpy(&out[written], &symbols[0], sizeof(float) * symbols.size());
+        written += symbols.size();
+      }
+      for (; i < end; i++)
+      {
+        const std::vector<float> & symbol = bits[i] ? d_data_1 : d_data_0;
+        memcpy(&out[written], &symbol[0], sizeof(float) * symbol.size());
+        written += symbol.size();
+      }
+      return written;
+    }
+
+    void command_waveforms::append(std::vector<float> & w, const bit_buffer & bits) const
+    {
+      for (int i = 0; i < bits.size(); i++)
+      {
+        const std::vector<float> & symbol = bits[i] ? d_data_1 : d_data_0;
+        w.insert(w.end(), symbol.begin(), symbol.end());
+      }
+    }
+
+    const std::vector<float> & command_waveforms::query(const bit_buffer & body)
+    {
+      // the key below only covers the fixed Query body; anything longer or
+      // shorter is a malformed command and must not alias a cached waveform
+      if (body.size() != QUERY_BODY_BITS)
+      {
+        log_text(LOG_VALUE, "| command_waveforms: malformed Query body, bits : ", body.size());
+        assert(body.size() == QUERY_BODY_BITS);
+        d_uncached.clear();
+        return d_uncached;
+      }
+
+      const uint32_t key = body.get(0, QUERY_BODY_BITS);
+
+      int s = (key * 2654435761u) >> 23;
+      while (d_query[s].used)
+      {
+        if (d_query[s].body == key)
+          return d_query[s].waveform;
+        s = (s + 1) & (QUERY_SLOTS - 1);
+      }
+
+      // first use of this body: append the CRC-5 and render. Past the load
+      // limit (far more variants than a run uses) it is rendered every time
+      bit_buffer bits;
+      bits.append(body, 0, QUERY_BODY_BITS);
+      bits.append(crc5_bits(bits, 0, QUERY_BODY_BITS), 5);
+
+      std::vector<float> & waveform = 2 * (d_query_count + 1) > QUERY_SLOTS ? d_uncached : d_query[s].waveform;
+      waveform = d_query_preamble;
+      append(waveform, bits);
+      if (&waveform != &d_uncached)
+      {
+        d_query[s].used = true;
+        d_query[s].body = key;
+        d_query_count++;
+      }
+      return waveform;
+    }
+
+  } /* namespace rfid */
+} /* namespace gr */
@@ -0,0 +1,85 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_RFID_COMMAND_WAVEFORMS_H
+#define INCLUDED_RFID_COMMAND_WAVEFORMS_H
+
+#include <rfid/bit_buffer.h>
+#include <stdint.h>
+#include <vector>
+
+namespace gr {
+  namespace rfid {
+
+    // PIE rendering of reader commands, with the fully rendered Query
+    // waveforms cached by command body.
+    //
+    // A Query body (the 17 bits before the CRC-5) only depends on DR, M,
+    // TRext, Sel, Session, Target and Q, so a run uses a few dozen variants.
+    // Each is rendered once (preamble + body + CRC-5) and sent with a single
+    // memcpy. Commands that carry an RN16 or handle are sent as a rendered
+    // constant prefix followed by the variable bits, copied a nibble at a
+    // time from the 16 pre-rendered nibble waveforms.
+    class command_waveforms
+    {
+      public:
+        static const int QUERY_BODY_BITS = 17;
+
+        command_waveforms();
+
+        // PIE symbols of data-0 and data-1, and the preamble that starts a Query
+        void init(const std::vector<float> & data_0,
+                  const std::vector<float> & data_1,
+                  const std::vector<float> & query_preamble);
+
+        // Write the PIE symbols of bits [first, first+count) at out,
+        // return the number of samples written
+        int render(float * out, const bit_buffer & bits, int first, int count) const;
+
+        // Append the PIE symbols of all bits to w (allocates, setup only)
+        void append(std::vector<float> & w, const bit_buffer & bits) const;
+
+        // Query waveform for the 17-bit body; rendered on the first use of
+        // a body (allocates), a table lookup afterwards. A body of any other
+        // length is rejected (asserts; empty waveform in release builds)
+        const std::vector<float> & query(const bit_buffer & body);
+
+      private:
+        // open addressing on the body, at most half full
+        static const int QUERY_SLOTS = 512;
+        struct query_entry
+        {
+          bool used;
+          uint32_t body;
+          std::vector<float> waveform;
+        };
+
+        std::vector<float> d_data_0, d_data_1, d_query_preamble;
+        std::vector<float> d_nibble[16];
+        std::vector<query_entry> d_query;
+        std::vector<float> d_uncached;
+        int d_query_count;
+    };
+
+  } // namespace rfid
+} // namespace gr
+
+#endif /* INCLUDED_RFID_COMMAND_WAVEFORMS_H */
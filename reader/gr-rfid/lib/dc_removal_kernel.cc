@@ -0,0 +1,160 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "dc_removal_kernel.h"
+#include "rfid/global_vars.h"
+#include <cmath>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define RFID_HAVE_X86
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RFID_HAVE_NEON
+#endif
+
+namespace gr {
+  namespace rfid {
+
+    void dc_scale_generic(gr_complex * out, float * msq, const gr_complex * in,
+                          const float * mag, gr_complex dc, unsigned int num_points)
+    {
+      const float dc_ampl = std::abs(dc);
+      for (unsigned int k = 0; k < num_points; k++)
+      {
+        out[k] = in[k] * (1 - dc_ampl / mag[k]);
+        msq[k] = std::norm(out[k]);
+      }
+    }
+
+    void dc_scale_rsqrt_generic(gr_complex * out, float * msq, const gr_complex * in,
+                                const float * mag, gr_complex dc, unsigned int num_points)
+    {
+      // scalar form of the SIMD kernels below (tails and other targets):
+      // reuses the gate's |in| instead of a square root per sample
+      const float dc_ampl = std::abs(dc);
+      for (unsigned int k = 0; k < num_points; k++)
+      {
+        float s = 1 - dc_ampl / mag[k];
+        float r = s * mag[k];
+        out[k] = in[k] * s;
+        msq[k] = r * r;
+      }
+    }
+
+    void dc_subtract_generic(gr_complex * out, float * msq, const gr_complex * in,
+                             const float *, gr_complex dc, unsigned int num_points)
+    {
+      for (unsigned int k = 0; k < num_points; k++)
+      {
+        out[k] = in[k] - dc;
+        msq[k] = std::norm(out[k]);
+      }
+    }
+
+#ifdef RFID_HAVE_X86
+    // 4 samples per iteration, deinterleaved into real and imaginary lanes
+    static void dc_scale_rsqrt_u_sse(gr_complex * out, float * msq, const gr_complex * in,
+                                     const float * mag, gr_complex dc, unsigned int num_points)
+    {
+      const float * in_f = (const float *) in;
+      float * out_f = (float *) out;
+      const __m128 dc_ampl = _mm_set1_ps(std::abs(dc));
+      const __m128 one = _mm_set1_ps(1.0f);
+      const __m128 half = _mm_set1_ps(0.5f);
+      const __m128 three_halves = _mm_set1_ps(1.5f);
+      unsigned int k = 0;
+      for (; k + 4 <= num_points; k += 4)
+      {
+        __m128 a = _mm_loadu_ps(in_f + 2 * k);
+        __m128 b = _mm_loadu_ps(in_f + 2 * k + 4);
+        __m128 re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        __m128 p = _mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im));
+
+        // y ~ 1/sqrt(p) to 12 bits, one Newton step: y * (1.5 - 0.5 * p * y^2)
+        __m128 y = _mm_rsqrt_ps(p);
+        y = _mm_mul_ps(y, _mm_sub_ps(three_halves, _mm_mul_ps(_mm_mul_ps(half, p), _mm_mul_ps(y, y))));
+
+        __m128 s = _mm_sub_ps(one, _mm_mul_ps(dc_ampl, y));
+        re = _mm_mul_ps(re, s);
+        im = _mm_mul_ps(im, s);
+        _mm_storeu_ps(msq + k, _mm_mul_ps(_mm_mul_ps(s, s), p));
+        _mm_storeu_ps(out_f + 2 * k, _mm_unpacklo_ps(re, im));
+        _mm_storeu_ps(out_f + 2 * k + 4, _mm_unpackhi_ps(re, im));
+      }
+      dc_scale_rsqrt_generic(out + k, msq + k, in + k, mag + k, dc, num_points - k);
+    }
+#endif
+
+#ifdef RFID_HAVE_NEON
+    // 4 samples per iteration
+    static void dc_scale_rsqrt_neon(gr_complex * out, float * msq, const gr_complex * in,
+                                    const float * mag, gr_complex dc, unsigned int num_points)
+    {
+      const float32x4_t dc_ampl = vdupq_n_f32(std::abs(dc));
+      const float32x4_t one = vdupq_n_f32(1.0f);
+      unsigned int k = 0;
+      for (; k + 4 <= num_points; k += 4)
+      {
+        float32x4x2_t x = vld2q_f32((const float *) (in + k));
+        float32x4_t p = vmlaq_f32(vmulq_f32(x.val[0], x.val[0]), x.val[1], x.val[1]);
+
+        // estimate and one Newton step (vrsqrts computes (3 - a*b) / 2)
+        float32x4_t y = vrsqrteq_f32(p);
+        y = vmulq_f32(y, vrsqrtsq_f32(vmulq_f32(p, y), y));
+
+        float32x4_t s = vmlsq_f32(one, dc_ampl, y);
+        x.val[0] = vmulq_f32(x.val[0], s);
+        x.val[1] = vmulq_f32(x.val[1], s);
+        vst1q_f32(msq + k, vmulq_f32(vmulq_f32(s, s), p));
+        vst2q_f32((float *) (out + k), x);
+      }
+      dc_scale_rsqrt_generic(out + k, msq + k, in + k, mag + k, dc, num_points - k);
+    }
+#endif
+
+    dc_removal_kernel_t dc_removal_kernel(int mode)
+    {
+      switch (mode)
+      {
+        case DC_REMOVAL_SUBTRACT:
+          return dc_subtract_generic;
+        case DC_REMOVAL_RSQRT:
+#if defined(RFID_HAVE_X86)
+          return dc_scale_rsqrt_u_sse;
+#elif defined(RFID_HAVE_NEON)
+          return dc_scale_rsqrt_neon;
+#else
+          return dc_scale_rsqrt_generic;
+#endif
+        default:
+          return dc_scale_generic;
+      }
+    }
+
+  } /* namespace rfid */
+} /* namespace gr */
@@ -0,0 +1,55 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_DC_REMOVAL_KERNEL_H
+#define INCLUDED_RFID_DC_REMOVAL_KERNEL_H
+
+#include <gnuradio/gr_complex.h>
+
+namespace gr {
+  namespace rfid {
+
+    // Kernels for the DC offset removal of the gate (open state). Each one
+    // writes the corrected samples and their squared magnitudes in a single
+    // pass:
+    //   scale:    out[k] = in[k] * (1 - |dc| / mag[k])      (mag[k] = |in[k]|)
+    //   rsqrt:    same, with 1/|in[k]| from a reciprocal square root estimate
+    //             of |in[k]|^2 refined by one Newton step (no sqrt, no divide);
+    //             the scalar fallback divides by mag[k] like scale
+    //   subtract: out[k] = in[k] - dc
+    //   msq[k] = |out[k]|^2
+    typedef void (*dc_removal_kernel_t)(gr_complex * out, float * msq,
+                                        const gr_complex * in, const float * mag,
+                                        gr_complex dc, unsigned int num_points);
+
+    void dc_scale_generic(gr_complex * out, float * msq, const gr_complex * in,
+                          const float * mag, gr_complex dc, unsigned int num_points);
+    void dc_scale_rsqrt_generic(gr_complex * out, float * msq, const gr_complex * in,
+                                const float * mag, gr_complex dc, unsigned int num_points);
+    void dc_subtract_generic(gr_complex * out, float * msq, const gr_complex * in,
+                             const float * mag, gr_complex dc, unsigned int num_points);
+
+    // Best implementation of the given DC_REMOVAL_MODE for the running CPU
+    dc_removal_kernel_t dc_removal_kernel(int mode);
+
+  } // namespace rfid
+} // namespace gr
+
+#endif /* INCLUDED_RFID_DC_REMOVAL_KERNEL_H */
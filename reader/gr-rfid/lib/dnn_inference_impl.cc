@@ -193,7 +193,6 @@ namespace gr {
 	    const int64_t es_scores_dims[2] = {batch_size, 4};
 	    const size_t nbytes_1 = 112 * batch_size * sizeof(float);
 	    const size_t nbytes_2 = batch_size * sizeof(float);
-	    const size_t nbytes_3 = 4 * batch_size * sizeof(float);
 	
 	    TF_Tensor* channel_response_t = TF_AllocateTensor(TF_FLOAT, channel_response_dims, 4, nbytes_1);
 	    memcpy(TF_TensorData(channel_response_t), batch_chrsp, nbytes_1);
@@ -242,18 +241,14 @@ namespace gr {
 				nbytes_2, TF_TensorByteSize(output_values[0]));
 		    //TF_DeleteTensor(amp_val[0]);
 		    TF_DeleteTensor(output_values[0]);
+		    TF_DeleteTensor(output_values[1]);
 		    return 0;
 	    }
 	
 	    // use global vals & needs some transformations
-	    float* amp_pred = (float*)malloc(nbytes_2);
-	    float* es_scores_pred = (float*)malloc(nbytes_3);
-	    
-	    memcpy(amp_pred, TF_TensorData(output_values[0]), nbytes_2);
-	    memcpy(es_scores_pred, TF_TensorData(output_values[1]), nbytes_3);
-	    
-	    TF_DeleteTensor(output_values[0]);
-	    //TF_DeleteTensor(es_scores_val[0]);
+	    // (read in place, the output tensors are freed once the scores are used)
+	    const float* amp_pred = (const float*)TF_TensorData(output_values[0]);
+	    const float* es_scores_pred = (const float*)TF_TensorData(output_values[1]);
 	    
 	    //printf("Predictions:\n");
 		batch_amp[0] = amp_pred[0];
@@ -273,8 +268,8 @@ namespace gr {
 	    }
 		*/
 		
-	    free(amp_pred);
-	    free(es_scores_pred);
+	    TF_DeleteTensor(output_values[0]);
+	    TF_DeleteTensor(output_values[1]);
 	    return 1;
     }
 
@@ -0,0 +1,75 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_ENCODING_TRAITS_H
+#define INCLUDED_RFID_ENCODING_TRAITS_H
+
+#include "rfid/global_vars.h"
+
+namespace gr {
+  namespace rfid {
+
+    // Compile-time description of each tag encoding (M = 1, 2, 4, 8), used to
+    // specialize the decoding pipeline of tag_decoder_impl.
+    //   preamble(), PREAMBLE_LEN, PREAMBLE_POWER : taps of the tag_sync correlator
+    //   SYNC_WINDOW_BITS     : candidate preamble offsets searched by tag_sync, in tag bits
+    //   SYNC_SHIFT_HALF_BITS : shift from the preamble start to the first data half-bit
+    template<int M> struct encoding_traits;
+
+    template<> struct encoding_traits<1>
+    {
+      static constexpr int PREAMBLE_LEN = FM0_PREAMBLE_LEN;
+      static constexpr int PREAMBLE_POWER = FM0_PREAMBLE_POWER;
+      static constexpr int SYNC_WINDOW_BITS = 8;
+      static constexpr int SYNC_SHIFT_HALF_BITS = PREAMBLE_LEN + 1;
+      static constexpr const int * preamble() { return TAG_PREAMBLE_FM0; }
+    };
+
+    template<> struct encoding_traits<2>
+    {
+      static constexpr int PREAMBLE_LEN = M2_PREAMBLE_LEN;
+      static constexpr int PREAMBLE_POWER = M2_PREAMBLE_POWER;
+      static constexpr int SYNC_WINDOW_BITS = 12;
+      static constexpr int SYNC_SHIFT_HALF_BITS = PREAMBLE_LEN;
+      static constexpr const int * preamble() { return TAG_PREAMBLE_M2; }
+    };
+
+    template<> struct encoding_traits<4>
+    {
+      static constexpr int PREAMBLE_LEN = M4_PREAMBLE_LEN;
+      static constexpr int PREAMBLE_POWER = M4_PREAMBLE_POWER;
+      static constexpr int SYNC_WINDOW_BITS = 18;
+      static constexpr int SYNC_SHIFT_HALF_BITS = PREAMBLE_LEN;
+      static constexpr const int * preamble() { return TAG_PREAMBLE_M4; }
+    };
+
+    template<> struct encoding_traits<8>
+    {
+      static constexpr int PREAMBLE_LEN = M8_PREAMBLE_LEN;
+      static constexpr int PREAMBLE_POWER = M8_PREAMBLE_POWER;
+      static constexpr int SYNC_WINDOW_BITS = 24;
+      static constexpr int SYNC_SHIFT_HALF_BITS = PREAMBLE_LEN;
+      static constexpr const int * preamble() { return TAG_PREAMBLE_M8; }
+    };
+
+  } // namespace rfid
+} // namespace gr
+
+#endif /* INCLUDED_RFID_ENCODING_TRAITS_H */
@@ -24,6 +24,9 @@
 
 #include <gnuradio/io_signature.h>
 #include "gate_impl.h"
+#include "alloc_guard.h"
+#include <volk/volk.h>
+#include <algorithm>
 #include <sys/time.h>
 #include <iostream>
 #include <fstream>
@@ -33,20 +36,29 @@ namespace gr {
   namespace rfid {
 
     gate::sptr
-    gate::make(int sample_rate)
+    gate::make(int sample_rate, int mf_taps, int decim)
     {
       return gnuradio::get_initial_sptr
-        (new gate_impl(sample_rate));
+        (new gate_impl(sample_rate, mf_taps, decim));
     }
     /*
      * The private constructor
      */
-    gate_impl::gate_impl(int sample_rate)
+    gate_impl::gate_impl(int sample_rate, int mf_taps, int decim)
       : gr::block("gate",
               gr::io_signature::make(1, 1, sizeof(gr_complex)),
               gr::io_signature::make(1, 1, sizeof(gr_complex))),
-              n_samples(0), win_index(0), dc_index(0), num_pulses(0), signal_state(NEG_EDGE), avg_ampl(0), dc_est(0,0)
+              n_samples(0), win_index(0), dc_index(0), num_pulses(0), signal_state(NEG_EDGE), avg_ampl(0), dc_est(0,0), dc_sum(0,0),
+              dc_removal(dc_removal_kernel(DC_REMOVAL)),
+              mf_taps(std::max(0, mf_taps)), decim(mf_taps > 0 ? std::max(1, decim) : 1)
     {
+      if (this->mf_taps > 0)
+      {
+        // each output needs the mf_taps newest input samples
+        set_history(this->mf_taps);
+        set_relative_rate(1.0 / this->decim);
+      }
+
       sp_rate = sample_rate;
       n_samples_T1       = T1_D       * (sample_rate / pow(10,6));
       n_samples_PW       = PW_D       * (sample_rate / pow(10,6));
@@ -55,8 +67,17 @@ namespace gr {
       win_length = WIN_SIZE_D * (sample_rate/ pow(10,6));
       dc_length  = DC_SIZE_D  * (sample_rate / pow(10,6));
 
-      win_samples.resize(win_length);
-      dc_samples.resize(dc_length);
+      // rings of power-of-two size: the sample leaving the window is the
+      // one written win_length (dc_length) samples earlier
+      int win_size = 1, dc_size = 1;
+      while (win_size < win_length)
+        win_size <<= 1;
+      while (dc_size < dc_length)
+        dc_size <<= 1;
+      win_mask = win_size - 1;
+      dc_mask = dc_size - 1;
+      win_samples.resize(win_size);
+      dc_samples.resize(dc_size);
 
       // set_max_output_buffer(2 * 8192);
 
@@ -69,6 +90,14 @@ namespace gr {
       // First block to be scheduled
       //GR_LOG_INFO(d_logger, "Initializing reader state...");
       initialize_reader_state();
+      reader_state->magn_squared_samples.reserve(max_tag_reply_samples(sample_rate));
+
+      // a call handles at most max_items samples, so the per-block buffers
+      // are sized once here
+      max_items = max_tag_reply_samples(sample_rate);
+      mag_samples.resize(max_items);
+      if (this->mf_taps > 0)
+        mf_samples.resize(max_items);
     } 
 
     /*
@@ -81,7 +110,61 @@ namespace gr {
     void
     gate_impl::forecast (int noutput_items, gr_vector_int &ninput_items_required)
     {
-        ninput_items_required[0] = noutput_items;
+        ninput_items_required[0] = noutput_items * decim + history() - 1;
+    }
+
+    int gate_impl::matched_filter(const gr_complex * in, int n_in, int max_out)
+    {
+      // Boxcar over mf_taps samples, one output every decim inputs:
+      //   mf[m] = sum_{j < mf_taps} in[m*decim + j]
+      // (in[] starts with the mf_taps-1 samples of history). Consecutive
+      // windows differ by decim samples at each end, so the sum is updated
+      // in O(decim) and recomputed every MF_RESYNC outputs to bound rounding.
+      // At most max_out outputs, the input behind them is left for the next call.
+      const int MF_RESYNC = 64;
+      int n_out = std::min((n_in - (mf_taps - 1)) / decim, max_out);
+      if (n_out <= 0)
+        return 0;
+
+      const bool running = 2 * decim < mf_taps;
+      gr_complex acc(0, 0);
+      for (int m = 0; m < n_out; m++)
+      {
+        const gr_complex * x = in + m * decim;
+        if (!running || m % MF_RESYNC == 0)
+        {
+          acc = gr_complex(0, 0);
+          for (int j = 0; j < mf_taps; j++)
+            acc += x[j];
+        }
+        else
+        {
+          for (int d = 0; d < decim; d++)
+            acc += x[mf_taps - decim + d] - x[d - decim];
+        }
+        mf_samples[m] = acc;
+      }
+      return n_out;
+    }
+
+    void gate_impl::track_ampl(float sample_ampl)
+    {
+      // Tracking average amplitude
+      avg_ampl = avg_ampl + (sample_ampl - win_samples[(win_index - win_length) & win_mask])/win_length;  
+      win_samples[win_index] = sample_ampl; 
+      win_index = (win_index + 1) & win_mask;
+
+      //Threshold for detecting negative/positive edges
+      sample_thresh = avg_ampl * THRESH_FRACTION;  
+    }
+
+    void gate_impl::write_gated(const gr_complex * in, const float * mag, gr_complex * out, int n)
+    {
+      // Remove offset from complex samples, keep |out|^2 for the decoder
+      std::vector<float> & msq = reader_state->magn_squared_samples;
+      int offset = msq.size();
+      msq.resize(offset + n);
+      dc_removal(out, &msq[offset], in, mag, dc_est, n);
     }
 
     int
@@ -90,11 +173,20 @@ namespace gr {
                        gr_vector_const_void_star &input_items,
                        gr_vector_void_star &output_items)
     {
+      RFID_NO_ALLOC_SCOPE("gate::general_work");
       n_samples_TAG_BIT  = TAG_BIT_D * (sp_rate / pow(10,6));
       const gr_complex *in = (const gr_complex *) input_items[0];
       gr_complex *out = (gr_complex *) output_items[0];
 
       int n_items = ninput_items[0];
+      if (mf_taps > 0)
+      {
+        // the gate below works on the filtered, decimated samples
+        // (no more outputs than the gate can write or buffer)
+        n_items = matched_filter(in, ninput_items[0], std::min(noutput_items, max_items));
+        in = &mf_samples[0];
+      }
+      n_items = std::min(n_items, max_items);
       int number_samples_consumed = n_items;
       float sample_ampl = 0;
       int written = 0;
@@ -151,92 +243,89 @@ namespace gr {
       
       if (reader_state->status == RUNNING)
       {
-        for(int i = 0; i < n_items; i++)
-        {
-          // Tracking average amplitude
-          sample_ampl = std::abs(in[i]);
-          avg_ampl = avg_ampl + (sample_ampl - win_samples[win_index])/win_length;  
-          win_samples[win_index] = sample_ampl; 
-          win_index = (win_index + 1) % win_length;
-  
-          //Threshold for detecting negative/positive edges
-          sample_thresh = avg_ampl * THRESH_FRACTION;  
+        // Magnitudes of the whole block at once, the per-sample loops below
+        // only read them
+        volk_32fc_magnitude_32f(&mag_samples[0], in, n_items);
 
+        int i = 0;
+        while (i < n_items && written < noutput_items)
+        {
           if( !(reader_state->gate_status == GATE_OPEN) )
           {
-            //cout << "stage 2" << endl;
-            //Tracking DC offset (only during T1)
-            dc_est =  dc_est + (in[i] - dc_samples[dc_index])/std::complex<float>(dc_length,0);  
-            dc_samples[dc_index] = in[i]; 
-            dc_index = (dc_index + 1) % dc_length;
-            
-            n_samples++;
-
-            // Potitive edge -> Negative edge
-            if( sample_ampl < sample_thresh && signal_state == POS_EDGE)
+            // Edge detection until a reader command is detected
+            for (; i < n_items; i++)
             {
-              n_samples = 0;
-              signal_state = NEG_EDGE;
-            }
-            // Negative edge -> Positive edge 
-            else if (sample_ampl > sample_thresh && signal_state == NEG_EDGE)
-            {
-              signal_state = POS_EDGE;
-              if (n_samples > n_samples_PW/2)
-                num_pulses++; 
-              else
-                num_pulses = 0; 
-              n_samples = 0;
-            }
+              sample_ampl = mag_samples[i];
+              track_ampl(sample_ampl);
 
-            if(n_samples > n_samples_T1 && signal_state == POS_EDGE && num_pulses > NUM_PULSES_COMMAND)
-            {
-              
-              //GR_LOG_INFO(d_logger, "READER COMMAND DETECTED");
-              reader_state->gate_status = GATE_OPEN;
+              //Tracking DC offset (only during T1)
+              dc_sum += in[i] - dc_samples[(dc_index - dc_length) & dc_mask];
+              dc_samples[dc_index] = in[i];
+              dc_index = (dc_index + 1) & dc_mask;
+              dc_est = dc_sum / (float) dc_length;
+
+              n_samples++;
 
-              reader_state->magn_squared_samples.resize(0);
+              // Potitive edge -> Negative edge
+              if( sample_ampl < sample_thresh && signal_state == POS_EDGE)
+              {
+                n_samples = 0;
+                signal_state = NEG_EDGE;
+              }
+              // Negative edge -> Positive edge 
+              else if (sample_ampl > sample_thresh && signal_state == NEG_EDGE)
+              {
+                signal_state = POS_EDGE;
+                if (n_samples > n_samples_PW/2)
+                  num_pulses++; 
+                else
+                  num_pulses = 0; 
+                n_samples = 0;
+              }
 
-              gr_complex temp = gr_complex((1 - abs(dc_est) / abs(in[i])), 0) * in[i];
-              reader_state->magn_squared_samples.push_back(std::norm(temp));
-              out[written] = temp;  
-              written++;
+              if(n_samples > n_samples_T1 && signal_state == POS_EDGE && num_pulses > NUM_PULSES_COMMAND)
+              {
+                //GR_LOG_INFO(d_logger, "READER COMMAND DETECTED");
+                reader_state->gate_status = GATE_OPEN;
+                reader_state->magn_squared_samples.resize(0);
 
-              num_pulses = 0; 
-              n_samples =  1; // Count number of samples passed to the next block
-              cw_ampl = 0.05 * cw_ampl + 0.95 * abs(dc_est);
+                write_gated(in + i, &mag_samples[i], out + written, 1);
+                written++;
+
+                num_pulses = 0; 
+                n_samples =  1; // Count number of samples passed to the next block
+                cw_ampl = 0.05 * cw_ampl + 0.95 * abs(dc_est);
+                i++;
+                break;
+              }
             }
-            
           }
           else
           {
-            
-            n_samples++;
-            gr_complex temp = gr_complex((1 - abs(dc_est) / abs(in[i])), 0) * in[i];
-            reader_state->magn_squared_samples.push_back(std::norm(temp));
-            out[written] = temp; // Remove offset from complex samples           
-            written++;
+            // Gate open: pass the rest of the tag reply in one run (dc_est
+            // is frozen until the gate closes), as far as the output allows
+            int n = std::min(n_items - i, std::max(1, reader_state->n_samples_to_ungate - n_samples));
+            n = std::min(n, noutput_items - written);
+            for (int k = i; k < i + n; k++)
+              track_ampl(mag_samples[k]);
+
+            write_gated(in + i, &mag_samples[i], out + written, n);
+            written += n;
+            n_samples += n;
+            i += n;
+
             if (n_samples >= reader_state->n_samples_to_ungate)
             {
-              /*
-              if (ENCODING_SCHEME == 10 && reader_state->reader_stats.aux_buffer_flag != 0) {
-                number_samples_consumed = i+1;
-                break;
-              }
-              else {
-                reader_state->gate_status = GATE_CLOSED;    
-                number_samples_consumed = i+1;
-                break;
-              }
-              */
               reader_state->gate_status = GATE_CLOSED;    
-              number_samples_consumed = i+1;
               break;
             }
           }
         }
+        // samples left over (output full, or the reply ended) wait for the
+        // next call
+        number_samples_consumed = i;
       }
-      consume_each (number_samples_consumed);
+      consume_each (number_samples_consumed * decim);
       
       return written;
     }
@@ -24,6 +24,7 @@
 #include <rfid/gate.h>
 #include <vector>
 #include "rfid/global_vars.h"
+#include "dc_removal_kernel.h"
 
 namespace gr { 
   namespace rfid {
@@ -35,16 +36,29 @@ namespace gr {
 
         int   n_samples, n_samples_T1, n_samples_PW, n_samples_TAG_BIT, sp_rate; 
         int  win_index, dc_index, win_length, dc_length, s_rate;
+        int  win_mask, dc_mask;
         float avg_ampl, num_pulses, sample_thresh;
 
         std::vector<float> win_samples,cw_samples;  
         std::vector<gr_complex> dc_samples;
-        gr_complex dc_est;
+        gr_complex dc_est, dc_sum;
+        dc_removal_kernel_t dc_removal;    // DC_REMOVAL mode, see dc_removal_kernel.h
+
+        int max_items;                     // samples handled per call
+        std::vector<float> mag_samples;    // |in| of the current block
+
+        // matched filter and decimation in front of the gate (mf_taps > 0)
+        int mf_taps, decim;
+        std::vector<gr_complex> mf_samples;
+        int matched_filter(const gr_complex * in, int n_in, int max_out);
+
+        void track_ampl(float sample_ampl);
+        void write_gated(const gr_complex * in, const float * mag, gr_complex * out, int n);
 
         SIGNAL_STATE signal_state;
 
        public:
-        gate_impl(int sample_rate);
+        gate_impl(int sample_rate, int mf_taps, int decim);
         ~gate_impl();
 
         void forecast (int noutput_items, gr_vector_int &ninput_items_required);
@@ -0,0 +1,144 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gen2_crc.h"
+
+namespace gr {
+  namespace rfid {
+
+    static const uint16_t CRC16_POLY = 0x1021;
+    static const uint8_t CRC5_POLY = 0x09;
+    static const uint16_t CRC16_PRESET = 0xFFFF;
+    static const uint8_t CRC5_PRESET = 0x09;
+
+    // table[k][x]: CRC-16 register contribution of byte x followed by k zero bytes
+    struct crc16_tables
+    {
+      uint16_t table[8][256];
+
+      crc16_tables()
+      {
+        for (int x = 0; x < 256; x++)
+        {
+          uint16_t crc = x << 8;
+          for (int j = 0; j < 8; j++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ CRC16_POLY : (crc << 1);
+          table[0][x] = crc;
+        }
+        for (int k = 1; k < 8; k++)
+          for (int x = 0; x < 256; x++)
+            table[k][x] = (table[k - 1][x] << 8) ^ table[0][table[k - 1][x] >> 8];
+      }
+    };
+
+    // CRC-5 register kept in the top five bits of a byte
+    struct crc5_table
+    {
+      uint8_t table[256];
+
+      crc5_table()
+      {
+        for (int x = 0; x < 256; x++)
+        {
+          uint8_t crc = x;
+          for (int j = 0; j < 8; j++)
+            crc = (crc & 0x80) ? (crc << 1) ^ (CRC5_POLY << 3) : (crc << 1);
+          table[x] = crc;
+        }
+      }
+    };
+
+    static const crc16_tables & crc16_lut()
+    {
+      static const crc16_tables lut;
+      return lut;
+    }
+
+    static const crc5_table & crc5_lut()
+    {
+      static const crc5_table lut;
+      return lut;
+    }
+
+    uint16_t crc16_bytewise(uint16_t crc, const uint8_t * data, size_t len)
+    {
+      const uint16_t * t = crc16_lut().table[0];
+      while (len--)
+        crc = t[(crc >> 8) ^ *data++] ^ (crc << 8);
+      return crc;
+    }
+
+    // Eight message bytes (first byte in the MSB of word) folded into crc
+    static inline uint16_t crc16_word(uint16_t crc, uint64_t word)
+    {
+      const crc16_tables & lut = crc16_lut();
+      word ^= (uint64_t) crc << 48;
+      return lut.table[7][(word >> 56) & 0xFF] ^ lut.table[6][(word >> 48) & 0xFF]
+           ^ lut.table[5][(word >> 40) & 0xFF] ^ lut.table[4][(word >> 32) & 0xFF]
+           ^ lut.table[3][(word >> 24) & 0xFF] ^ lut.table[2][(word >> 16) & 0xFF]
+           ^ lut.table[1][(word >> 8) & 0xFF] ^ lut.table[0][word & 0xFF];
+    }
+
+    uint16_t crc16_slice8(uint16_t crc, const uint8_t * data, size_t len)
+    {
+      for (; len >= 8; len -= 8, data += 8)
+      {
+        uint64_t word = 0;
+        for (int k = 0; k < 8; k++)
+          word = (word << 8) | data[k];
+        crc = crc16_word(crc, word);
+      }
+      return crc16_bytewise(crc, data, len);
+    }
+
+    uint16_t crc16_bits(const bit_buffer & bits, int first, int num_bits)
+    {
+      const uint16_t * t = crc16_lut().table[0];
+      uint16_t crc = CRC16_PRESET;
+
+      for (; num_bits >= 64; num_bits -= 64, first += 64)
+        crc = crc16_word(crc, bits.get(first, 64));
+      for (; num_bits >= 8; num_bits -= 8, first += 8)
+        crc = t[(crc >> 8) ^ bits.get(first, 8)] ^ (crc << 8);
+      for (; num_bits > 0; num_bits--, first++)
+        crc = (((crc >> 15) ^ bits[first]) & 1) ? (crc << 1) ^ CRC16_POLY : (crc << 1);
+
+      return ~crc;
+    }
+
+    uint8_t crc5_bits(const bit_buffer & bits, int first, int num_bits)
+    {
+      const uint8_t * t = crc5_lut().table;
+      uint8_t crc = CRC5_PRESET << 3;
+
+      for (; num_bits >= 8; num_bits -= 8, first += 8)
+        crc = t[crc ^ bits.get(first, 8)];
+      for (; num_bits > 0; num_bits--, first++)
+        crc = (((crc >> 7) ^ bits[first]) & 1) ? (crc << 1) ^ (CRC5_POLY << 3) : (crc << 1);
+
+      return crc >> 3;
+    }
+
+  } /* namespace rfid */
+} /* namespace gr */
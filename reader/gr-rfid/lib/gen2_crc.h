@@ -0,0 +1,55 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_GEN2_CRC_H
+#define INCLUDED_RFID_GEN2_CRC_H
+
+#include <rfid/bit_buffer.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace gr {
+  namespace rfid {
+
+    // CRCs of the EPC Gen2 air interface.
+    //
+    // CRC-16/CCITT: polynomial 0x1021, preset 0xFFFF, MSB first. The byte
+    // functions return the raw register (no final complement), like the
+    // WISP firmware's crc16_cLUT() in multi_rate_wisp/CCS/wisp-base/Math;
+    // the bit_buffer functions return the complemented value that goes on
+    // air. CRC-5: polynomial x^5 + x^3 + 1, preset 01001 (Query command).
+
+    // Byte-at-a-time lookup, same table as the firmware
+    uint16_t crc16_bytewise(uint16_t crc, const uint8_t * data, size_t len);
+
+    // Slicing-by-8: eight bytes per step
+    uint16_t crc16_slice8(uint16_t crc, const uint8_t * data, size_t len);
+
+    // Gen2 CRC-16 of num_bits bits of a packed buffer starting at first
+    // (any bit count, any alignment)
+    uint16_t crc16_bits(const bit_buffer & bits, int first, int num_bits);
+
+    // Gen2 CRC-5 of num_bits bits of a packed buffer starting at first
+    uint8_t crc5_bits(const bit_buffer & bits, int first, int num_bits);
+
+  } // namespace rfid
+} // namespace gr
+
+#endif /* INCLUDED_RFID_GEN2_CRC_H */
@@ -25,16 +25,15 @@
 #include <gnuradio/io_signature.h>
 #include "rfid/global_vars.h"
 
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
 namespace gr {
   namespace rfid {
     // the following params should be updated for each query in the rate adaptation algorithm
     int valid_packet = 0;
-    int prev_transmission_state = -1;
     int curr_transmission_state = -1;
-    int n_consecutive_success = 0;
-    int n_consecutive_failure = 0;
-    int just_elevated = 0;
     
     int ENCODING_SCHEME = index_ES_LIST[index_ES]; // 1/2/4/8 --> FM0/M2/M4/M8
     gr_complex preamble_fm0[6 * 14 * 100] = {gr_complex(0, 0)};
@@ -51,41 +50,6 @@ namespace gr {
     
     float C_th = C_th_LIST[ENCODING_SCHEME];
 
-    int PROBING_MODE = -1;
-    float pktloss_table[4] = {0, 0, 0, 0};
-    int probing_rate_cnt = 3; // rate index
-    int probing_cnt = 3; // count of single rate
-    int n_success = 0;
-    clock_t dwelling_clk_start;
-    clock_t minstrel_timer;
-    // end here
-
-
-    //BLINK
-    int BLINK_MODE = 0; // (0: IDLE, 1: PROBING)
-    int blink_scan_cnt = 1;
-    int blink_scan_start = 1;
-    clock_t blink_timer = clock();
-    float blink_pktloss_realtime = 0;
-    float blink_pktloss_firstscan = 0;
-    float blink_pktloss_secondscan = 0;
-    float blink_RSSI_firstscan = 0;
-    float blink_RSSI_secondscan = 0;
-    float blink_pktloss_probe = 0;
-    float blink_RSSI_probe = 0;
-    float blink_n_success = 1E-4;
-    float blink_n_failure = 0;
-
-    //MobiRate
-    float lambda = 0.07; // exponential coefficient
-    int MobiRate_MODE = 0; // (0: KEEP, 1: HIGHER, 2: LOWER) 
-    clock_t mobirate_timer1 = clock();
-    clock_t mobirate_timer2 = clock();
-    float mobirate_phase_realtime = 0;
-    int mobirate_phase_scan_cnt = 0;
-    int mobirate_n_failure = 0;
-    float mobirate_pktloss_table[4] = {0};
-    
     // signal params
     float RSSI = 1E-10;
     float Phase = 0;
@@ -173,7 +137,6 @@ namespace gr {
     int retran_goodput_pkt_prev_cnt = 0;
 
     READER_STATE * reader_state;
-    float RN16_handle_stored[16];
     void initialize_reader_state()
     {
       reader_state = new READER_STATE;
@@ -201,9 +164,9 @@ namespace gr {
       reader_state-> reader_stats.n_1 = 0; //Number of success slots per frame
       reader_state-> reader_stats.n_0 = 0; //Number of idle slots per frame
 
-      reader_state-> reader_stats.VAR_Q = 1; //Initial Q value -> L=2^Q
-      reader_state-> reader_stats.Qant = 1; 
-      reader_state-> reader_stats.Qfp = 1.0; 
+      reader_state-> reader_stats.VAR_Q = Q_SELECTION == Q_SELECT_FIXED ? FIXED_Q : Q_INITIAL; //Initial Q value -> L=2^Q
+      reader_state-> reader_stats.Qant = reader_state-> reader_stats.VAR_Q; 
+      reader_state-> reader_stats.Qfp = reader_state-> reader_stats.VAR_Q; 
 
       reader_state-> reader_stats.Qupdn = 0; 
 
@@ -228,12 +191,13 @@ namespace gr {
 
       std::vector<int>  unique_tags_round;
       std::map<int,int> tag_reads; 
-      std::vector<float> RN16_bits_handle;  
-      std::vector<float> RN16_bits_read; 
+      bit_buffer RN16_bits_handle;
+      bit_buffer RN16_bits_read;
 
       reader_state-> status           = RUNNING;
       reader_state-> gen2_logic_status= START;
       reader_state-> gate_status       = GATE_SEEK_RN16;
+      reader_state-> n_samples_to_ungate = 0;
       reader_state-> decoder_status   = DECODER_DECODE_RN16;
 
       reader_state-> reader_stats.max_slot_number = pow(2,FIXED_Q);
@@ -243,6 +207,33 @@ namespace gr {
 
       //gettimeofday (&reader_state-> reader_stats.start, NULL);
     }
+
+    static std::mutex reader_state_mutex;
+    static std::condition_variable reader_state_cv;
+
+    void notify_reader_state()
+    {
+      // the lock orders the decoder's writes to reader_state before the
+      // reader's check of gen2_logic_status
+      {
+        std::lock_guard<std::mutex> lock(reader_state_mutex);
+      }
+      reader_state_cv.notify_one();
+    }
+
+    bool wait_reader_state(int timeout_ms)
+    {
+      std::unique_lock<std::mutex> lock(reader_state_mutex);
+      return reader_state_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                                      []() { return reader_state->gen2_logic_status != IDLE; });
+    }
+
+    int max_tag_reply_samples(int sample_rate)
+    {
+      float max_tag_bit_D = 1.0 * MAX_ENCODING_SCHEME / T_READER_FREQ * pow(10,6);
+      int n_samples_TAG_BIT = max_tag_bit_D * (sample_rate / pow(10,6));
+      return (EPC_BITS + TAG_PREAMBLE_BITS + 10) * n_samples_TAG_BIT + 1;
+    }
   } /* namespace rfid */
 } /* namespace gr */
 
@@ -0,0 +1,88 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "link_profile.h"
+#include "rfid/global_vars.h"
+#include <math.h>
+
+namespace gr {
+  namespace rfid {
+
+    void link_profile::init(int encoding, float sample_d)
+    {
+      M = encoding;
+      if (M == 1)
+      {
+        m_field = M_FM0;
+        bulky_N = 3;
+      }
+      else if (M == 2)
+      {
+        m_field = M_Miller2;
+        bulky_N = 2;
+      }
+      else if (M == 4)
+      {
+        m_field = M_Miller4;
+        bulky_N = 1;
+      }
+      else
+      {
+        m_field = M_Miller8;
+        bulky_N = 1;
+      }
+
+      TAG_BIT_D   = 1.0 * M/T_READER_FREQ * pow(10,6); // Duration in us
+      RN16_D      = (RN16_BITS + TAG_PREAMBLE_BITS) * TAG_BIT_D;
+      EPC_D       = (EPC_BITS  + TAG_PREAMBLE_BITS) * TAG_BIT_D;
+      HANDLE_D    = (RN16_BITS - 1  + TAG_PREAMBLE_BITS + 16) * TAG_BIT_D; // RN16 without? dummy-bit
+      READ_D      = (1 + 32+ 16 + 16+ TAG_PREAMBLE_BITS ) * TAG_BIT_D; // RN16 without? dummy-bit
+
+      Tsk = T1_D + RN16_D + T2_D + Tack + T1_D + EPC_D + T2_D;  //Duration of single/collision slot in us
+      Ti  = T1_D + RN16_D + T2_D; //Duration of idle slot in us
+
+      C_th = C_th_LIST[M];
+
+      int n_cwquery_s = (T1_D+T2_D+RN16_D)/sample_d;     //RN16
+      int n_cwack_s   = (1*T1_D+T2_D+EPC_D)/sample_d;    //EPC   if it is longer than nominal it wont cause tags to change inventoried flag
+      cw_query.assign(n_cwquery_s, 1);
+      cw_ack.assign(n_cwack_s, 1);
+    }
+
+    void link_profile::apply() const
+    {
+      // the members shadow the globals of the same name
+      rfid::TAG_BIT_D = TAG_BIT_D;
+      rfid::RN16_D    = RN16_D;
+      rfid::EPC_D     = EPC_D;
+      rfid::HANDLE_D  = HANDLE_D;
+      rfid::READ_D    = READ_D;
+      rfid::Tsk       = Tsk;
+      rfid::Ti        = Ti;
+      rfid::C_th      = C_th;
+    }
+
+  } /* namespace rfid */
+} /* namespace gr */
@@ -0,0 +1,58 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_RFID_LINK_PROFILE_H
+#define INCLUDED_RFID_LINK_PROFILE_H
+
+#include <vector>
+
+namespace gr {
+  namespace rfid {
+
+    // Link timing of one tag encoding (M = 1, 2, 4, 8): the durations of
+    // global_vars.h (in us) and the CW sent while the tag replies. Built
+    // once per encoding, so a rate switch is an index change.
+    struct link_profile
+    {
+      int M;
+      const int * m_field;   // M field of the Query (2 bits)
+      int bulky_N;           // EPCs per bulk transfer used by the rate controllers
+      float TAG_BIT_D, RN16_D, EPC_D, HANDLE_D, READ_D, Tsk, Ti, C_th;
+      std::vector<float> cw_query;  // after Query/QueryRep: RN16
+      std::vector<float> cw_ack;    // after ACK: EPC
+
+      void init(int encoding, float sample_d);
+
+      // Publish the durations to the globals read by the gate and the decoder
+      void apply() const;
+    };
+
+    // Position of encoding M in index_ES_LIST (anything else maps to Miller-8,
+    // like the M field of the Query)
+    inline int link_profile_index(int M)
+    {
+      return M == 1 ? 3 : M == 2 ? 2 : M == 4 ? 1 : 0;
+    }
+
+  } // namespace rfid
+} // namespace gr
+
+#endif /* INCLUDED_RFID_LINK_PROFILE_H */
@@ -47,7 +47,11 @@ namespace gr {
     pbr_feature_extractor_impl::pbr_feature_extractor_impl(int sample_rate)
       : gr::sync_block("pbr_feature_extractor",
               gr::io_signature::make(1, 1, sizeof(gr_complex)),
-              gr::io_signature::make(0, 0, 0))
+              gr::io_signature::make(0, 0, 0)),
+              sync_fm0(TAG_PREAMBLE_FM0, FM0_PREAMBLE_LEN, FM0_PREAMBLE_POWER),
+              sync_m2(TAG_PREAMBLE_M2, M2_PREAMBLE_LEN, M2_PREAMBLE_POWER),
+              sync_m4(TAG_PREAMBLE_M4, M4_PREAMBLE_LEN, M4_PREAMBLE_POWER),
+              sync_m8(TAG_PREAMBLE_M8, M8_PREAMBLE_LEN, M8_PREAMBLE_POWER)
     {
       //char_bits = (char *) malloc( sizeof(char) * 128);
       //char_bits_HANDLE = (char *) malloc( sizeof(char) * 32);
@@ -66,33 +70,15 @@ namespace gr {
     int pbr_feature_extractor_impl::tag_sync(const gr_complex * in , int size, int flag)
     {
       int max_index = 0;
-      float max = 0,corr,cc;
-      gr_complex corr2;
+      int tap_spacing = (int) (n_samples_TAG_BIT/2);
+      preamble_sync_result sync;
       
       if (flag == 1){ // FM0 encoding
-        //n_samples_TAG_BIT = 14;
         // Do not have to check entire vector (not optimal)
-        for (int i=0; i < 8 * n_samples_TAG_BIT ; i++)
-        {
-          corr2 = gr_complex(0,0);
-          corr = 0;
-	        cc = 0;
-
-          // sync after matched filter (equivalent)
-          for (int j = 0; j < FM0_PREAMBLE_LEN; j ++)
-          {
-            corr2 = corr2 + in[ (int) (i+j*n_samples_TAG_BIT/2) ] * gr_complex(TAG_PREAMBLE_FM0[j],0);
-	          cc = cc + std::norm(in[(int) (i+j*n_samples_TAG_BIT/2)]);
-          }
-          corr = std::norm(corr2) / (FM0_PREAMBLE_POWER * cc);
-          if (corr > max)
-          {
-            max = corr;
-            max_index = i;
-          }
-        }  
+        sync = sync_fm0.search(in, 8 * n_samples_TAG_BIT, tap_spacing);
+        max_index = sync.index;
 
-        output_energy = max;
+        output_energy = sync.corr;
         //GR_LOG_INFO(d_logger, " Energy of received signal when RN16: " << reader_state->reader_stats.output_energy);
 
         // Preamble ({1,1,-1,1,-1,-1,1,-1,-1,-1,1,1} 1 2 4 7 11 12)) 
@@ -105,35 +91,12 @@ namespace gr {
  
       else if(flag == 2) //M2 encoding
       {
-        // n_samples_TAG_BIT = 14; 
-        gr_complex corr2_f = gr_complex(0,0);
-        // Do not have to check entire vector (not optimal)
-        for (int i=0; i < 16  * n_samples_TAG_BIT ; i++)
-        {
-
-          corr2 = gr_complex(0,0);
-          corr = 0;
-          cc = 0;
+        sync = sync_m2.search(in, 16 * n_samples_TAG_BIT, tap_spacing);
+        max_index = sync.index;
 
-          // sync after matched filter (equivalent)
-          for (int j = 0; j < M2_PREAMBLE_LEN; j ++)
-          {
-            corr2 = corr2 + in[ (int) (i+j*n_samples_TAG_BIT/2) ] * gr_complex(TAG_PREAMBLE_M2[j],0);
-            cc = cc + std::norm(in[(int) (i+j*n_samples_TAG_BIT/2)]);
-          }
-          corr = std::norm(corr2) / (M2_PREAMBLE_POWER * cc);
-          if (corr > max)
-          {
-            max = corr;
-            max_index = i;
-            corr2_f = corr2;
-          }
+        output_energy = sync.corr;
 
-        }
-
-        output_energy = max;
-
-        h_est = corr2_f / std::complex<float>(M2_PREAMBLE_POWER,0);
+        h_est = sync.corr2 / std::complex<float>(M2_PREAMBLE_POWER,0);
 
         // Shifted received waveform by n_samples_TAG_BIT/2
         max_index = max_index + M2_PREAMBLE_LEN * n_samples_TAG_BIT / 2;   
@@ -142,35 +105,12 @@ namespace gr {
 
       else if(flag == 4) //M4 encoding
       {
-        // n_samples_TAG_BIT = 14; 
-        gr_complex corr2_f = gr_complex(0,0);
-        // Do not have to check entire vector (not optimal)
-        for (int i=0; i < 32 * n_samples_TAG_BIT ; i++)
-        {
+        sync = sync_m4.search(in, 32 * n_samples_TAG_BIT, tap_spacing);
+        max_index = sync.index;
 
-          corr2 = gr_complex(0,0);
-          corr = 0;
-          cc = 0;
+        output_energy = sync.corr;
 
-          // sync after matched filter (equivalent)
-          for (int j = 0; j < M4_PREAMBLE_LEN; j ++)
-          {
-            corr2 = corr2 + in[ (int) (i+j*n_samples_TAG_BIT/2) ] * gr_complex(TAG_PREAMBLE_M4[j],0);
-            cc = cc + std::norm(in[(int) (i+j*n_samples_TAG_BIT/2)]);
-          }
-          corr = std::norm(corr2) / (M4_PREAMBLE_POWER * cc);
-          if (corr > max)
-          {
-            max = corr;
-            max_index = i;
-            corr2_f = corr2;
-          }
-
-        }
-
-        output_energy = max;
-
-        h_est = corr2_f / std::complex<float>(M4_PREAMBLE_POWER,0);
+        h_est = sync.corr2 / std::complex<float>(M4_PREAMBLE_POWER,0);
 
         // Shifted received waveform by n_samples_TAG_BIT/2
         max_index = max_index + M4_PREAMBLE_LEN * n_samples_TAG_BIT / 2;   
@@ -178,38 +118,12 @@ namespace gr {
 
       else if(flag == 8) //M8 encoding
       {
-        // n_samples_TAG_BIT = 14; 
-        gr_complex corr2_f = gr_complex(0,0);
-        // Do not have to check entire vector (not optimal)
-        for (int i=0; i < 32 * n_samples_TAG_BIT ; i++)
-        {
-
-          corr2 = gr_complex(0,0);
-          corr = 0;
-          cc = 0;
-          // sync after matched filter (equivalent)
-          
-          for (int j = 0; j < M8_PREAMBLE_LEN; j ++)
-          {
-            corr2 = corr2 + in[ (int) (i+j*n_samples_TAG_BIT/2) ] * gr_complex(TAG_PREAMBLE_M8[j],0);
-            cc = cc + std::norm(in[(int) (i+j*n_samples_TAG_BIT/2)]);
-              
-                 
-	    //cout << "[ " << in[(int) (i+j*n_samples_TAG_BIT/2)] << " ] " << endl;
-          }
-          corr = std::norm(corr2) / (M8_PREAMBLE_POWER * cc);
-          if (corr > max)
-          {
-            max = corr;
-            max_index = i;
-            corr2_f = corr2;
-          }
-          
-        }
+        sync = sync_m8.search(in, 32 * n_samples_TAG_BIT, tap_spacing);
+        max_index = sync.index;
         // cout << "max_index: " << max_index << endl;
-        output_energy = max;
+        output_energy = sync.corr;
         //cout << "max: " << max << endl;
-        h_est = corr2_f / std::complex<float>(M8_PREAMBLE_POWER,0);
+        h_est = sync.corr2 / std::complex<float>(M8_PREAMBLE_POWER,0);
  
         // Shifted received waveform by n_samples_TAG_BIT/2
         max_index = max_index + M8_PREAMBLE_LEN * n_samples_TAG_BIT / 2;   
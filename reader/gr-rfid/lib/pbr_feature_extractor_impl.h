@@ -25,6 +25,7 @@
 #include <vector>
 #include <rfid/interaction_global_vars.h>
 #include "rfid/pbr_global_vars.h"
+#include "preamble_correlator.h"
 #include <time.h>
 #include <numeric>
 #include <fstream>
@@ -38,6 +39,10 @@ namespace gr {
       float output_energy;
       float n_samples_TAG_BIT;
       gr_complex h_est;
+      preamble_correlator sync_fm0;
+      preamble_correlator sync_m2;
+      preamble_correlator sync_m4;
+      preamble_correlator sync_m8;
       int tag_sync(const gr_complex * in, int size, int flag);
 
      public:
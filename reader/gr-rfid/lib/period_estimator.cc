@@ -0,0 +1,255 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "period_estimator.h"
+#include <algorithm>
+#include <cmath>
+
+namespace gr {
+  namespace rfid {
+
+    // Coarse acquisition: grid over the whole [min_val, max_val] on a short prefix
+    static const int ACQ_POINTS = 32;
+    static const int ACQ_GRID = 17;
+    // Fine tracking: blocks of the remaining points, integer shifts searched per block
+    static const int TRACK_BLOCK = 16;
+    static const int TRACK_SHIFT = 3;
+    // Verification of a previous estimate: integer shifts searched per block
+    static const int VERIFY_SHIFT = 3;
+    static const int MAX_SHIFT = 3;
+    // Spectral search: zero-padding factor of the FFT
+    static const int SPECTRAL_PAD = 2;
+
+    period_estimator::period_estimator()
+      : d_reads(0)
+    {
+    }
+
+    float period_estimator::energy(const float * msq, int index, int num_points, float T)
+    {
+      float e = 0;
+      for (int i = 0; i < num_points; i++)
+        e += msq[(int) (i * T + index)];
+      return e;
+    }
+
+    float period_estimator::eval(const float * msq, int index, int num_points, float T)
+    {
+      d_reads += num_points;
+      return energy(msq, index, num_points, T);
+    }
+
+    float period_estimator::snap(float T, float min_val, float max_val, int number_steps)
+    {
+      int index_T = (int) std::floor((T - min_val) / (max_val - min_val) * (number_steps - 1) + 0.5f);
+      index_T = std::max(0, std::min(number_steps - 1, index_T));
+      return min_val + index_T*(max_val-min_val)/(number_steps-1);
+    }
+
+    float period_estimator::exhaustive(const float * msq, int index, int num_points,
+                                       float min_val, float max_val, int number_steps)
+    {
+      d_energy.assign(number_steps, 0);
+      for (int t = 0; t < number_steps; t++)
+      {
+        float T_candidate = min_val + t*(max_val-min_val)/(number_steps-1);
+        d_energy[t] = eval(msq, index, num_points, T_candidate);
+      }
+
+      int index_T = std::distance(d_energy.begin(), std::max_element(d_energy.begin(), d_energy.end()));
+      return min_val + index_T*(max_val-min_val)/(number_steps-1);
+    }
+
+    // Vertex offset (in grid steps, within [-0.5, 0.5]) of the parabola through e[-1], e[0], e[1]
+    static float parabolic_offset(const float * e)
+    {
+      float den = e[-1] - 2 * e[0] + e[1];
+      if (den >= 0)
+        return 0;
+      return std::max(-0.5f, std::min(0.5f, 0.5f * (e[-1] - e[1]) / den));
+    }
+
+    bool period_estimator::block_offset(const float * msq, int index, int i0, int n,
+                                        float T, int max_shift, float & tau)
+    {
+      float shift_energy[2 * MAX_SHIFT + 1];
+      int best_shift = 0;
+      for (int s = -max_shift; s <= max_shift; s++)
+      {
+        float acc = 0;
+        for (int k = 0; k < n; k++)
+          acc += msq[(int) ((i0 + k) * T + index) + s];
+        shift_energy[s + max_shift] = acc;
+        if (acc > shift_energy[best_shift])
+          best_shift = s + max_shift;
+      }
+      d_reads += (2 * max_shift + 1) * n;
+
+      tau = best_shift - max_shift;
+      if (best_shift == 0 || best_shift == 2 * max_shift)
+        return false;
+      tau += parabolic_offset(&shift_energy[best_shift]);
+      return true;
+    }
+
+    float period_estimator::coarse_to_fine(const float * msq, int index, int num_points,
+                                           float min_val, float max_val, int number_steps)
+    {
+      // 1) Acquisition: E(T) on a coarse grid over the first ACQ_POINTS points,
+      //    refined by a parabolic fit around the best grid point
+      const int n_acq = std::min(num_points, ACQ_POINTS);
+      const float acq_step = (max_val - min_val) / (ACQ_GRID - 1);
+      float e[ACQ_GRID];
+      int best = 0;
+      for (int k = 0; k < ACQ_GRID; k++)
+      {
+        e[k] = eval(msq, index, n_acq, min_val + k * acq_step);
+        if (e[k] > e[best])
+          best = k;
+      }
+      float T = min_val + best * acq_step;
+      if (best > 0 && best < ACQ_GRID - 1)
+        T += parabolic_offset(&e[best]) * acq_step;
+
+      // 2) Tracking: with T known to a fraction of a sample over the prefix, the
+      //    position of half-bit i drifts by i*(T_true - T). For every block of
+      //    the remaining points find the shift (integer grid + parabolic
+      //    refinement) that maximizes the block energy, and refit T by least
+      //    squares on the positions measured so far (origin at index).
+      double sxy = 0, sxx = 0;
+      {
+        double mid = 0.5 * (n_acq - 1);
+        sxy = n_acq * mid * (mid * T);
+        sxx = n_acq * mid * mid;
+      }
+
+      for (int i0 = n_acq; i0 < num_points; i0 += TRACK_BLOCK)
+      {
+        const int n = std::min(TRACK_BLOCK, num_points - i0);
+        float tau;
+        block_offset(msq, index, i0, n, T, TRACK_SHIFT, tau);
+
+        double mid = i0 + 0.5 * (n - 1);
+        sxy += n * mid * (mid * T + tau);
+        sxx += n * mid * mid;
+        T = std::max(min_val, std::min(max_val, (float) (sxy / sxx)));
+      }
+
+      return snap(T, min_val, max_val, number_steps);
+    }
+
+    float period_estimator::spectral(const float * msq, int index, int num_points,
+                                     float min_val, float max_val, int number_steps)
+    {
+      const int len = (int) (num_points * 0.5f * (min_val + max_val));
+      int fft_size = 1;
+      while (fft_size < SPECTRAL_PAD * len)
+        fft_size <<= 1;
+
+      std::unique_ptr<gr::fft::fft_real_fwd> & fft = d_fft[fft_size];
+      if (!fft)
+        fft.reset(new gr::fft::fft_real_fwd(fft_size));
+
+      // edge signal (squared curvature of the envelope), zero mean, zero-padded
+      float * in = fft->get_inbuf();
+      float mean = 0;
+      for (int k = 0; k < len; k++)
+      {
+        float d = msq[index + k + 1] - 2 * msq[index + k] + msq[index + k - 1];
+        in[k] = d * d;
+        mean += in[k];
+      }
+      mean /= len;
+      for (int k = 0; k < len; k++)
+        in[k] -= mean;
+      std::fill(in + len, in + fft_size, 0.0f);
+      d_reads += len + 2;
+
+      fft->execute();
+      const gr_complex * out = fft->get_outbuf();
+
+      // strongest bin in the band of admissible half-bit rates
+      int k_lo = std::max(1, (int) std::floor(fft_size / max_val));
+      int k_hi = std::min(fft_size / 2 - 1, (int) std::ceil(fft_size / min_val));
+      int k_best = k_lo;
+      float p_best = 0;
+      for (int k = k_lo; k <= k_hi; k++)
+      {
+        float p = std::norm(out[k]);
+        if (p > p_best)
+        {
+          p_best = p;
+          k_best = k;
+        }
+      }
+
+      // Gaussian interpolation: parabola through the log-power of the neighbours
+      float e[3];
+      for (int j = 0; j < 3; j++)
+        e[j] = std::log(std::norm(out[k_best - 1 + j]) + 1e-30f);
+      float freq = (k_best + parabolic_offset(&e[1])) / fft_size;
+
+      float T = std::max(min_val, std::min(max_val, 1.0f / freq));
+      return snap(T, min_val, max_val, number_steps);
+    }
+
+    float period_estimator::verify(const float * msq, int index, int num_points,
+                                   float min_val, float max_val, int number_steps,
+                                   float T_prev, float tolerance, bool & ok)
+    {
+      ok = false;
+      if (T_prev < min_val || T_prev > max_val)
+        return T_prev;
+
+      // blocks ending at num_points/2^k, visited from the start of the packet
+      const int n = std::min(TRACK_BLOCK, num_points);
+      int levels = 0;
+      while ((num_points >> (levels + 1)) >= 2 * n)
+        levels++;
+
+      float T = T_prev;
+      double sxy = 0, sxx = 0;
+      for (int level = levels; level >= 0; level--)
+      {
+        const int i0 = (num_points >> level) - n;
+        // the remaining drift must be caught inside the window
+        float tau;
+        if (!block_offset(msq, index, i0, n, T, VERIFY_SHIFT, tau))
+          return T_prev;
+
+        double mid = i0 + 0.5 * (n - 1);
+        sxy += n * mid * (mid * T + tau);
+        sxx += n * mid * mid;
+        T = (float) (sxy / sxx);
+      }
+
+      if (std::fabs(T - T_prev) > tolerance || T < min_val || T > max_val)
+        return T_prev;
+
+      ok = true;
+      return snap(T, min_val, max_val, number_steps);
+    }
+
+  } /* namespace rfid */
+} /* namespace gr */
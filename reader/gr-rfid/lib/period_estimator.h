@@ -0,0 +1,98 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_PERIOD_ESTIMATOR_H
+#define INCLUDED_RFID_PERIOD_ESTIMATOR_H
+
+#include <gnuradio/fft/fft.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace gr {
+  namespace rfid {
+
+    // Estimation of the tag half-bit period T (in samples) from the
+    // magnitude-squared envelope. All strategies maximize
+    //   E(T) = sum_{i < num_points} msq[(int) (i*T + index)]
+    // over T in [min_val, max_val] and return a value on the grid
+    // min_val + k*(max_val-min_val)/(number_steps-1).
+    class period_estimator
+    {
+      public:
+        period_estimator();
+
+        static float energy(const float * msq, int index, int num_points, float T);
+
+        // Evaluate E(T) on all number_steps grid points
+        float exhaustive(const float * msq, int index, int num_points,
+                         float min_val, float max_val, int number_steps);
+
+        // Coarse-to-fine search: a coarse grid on a short prefix of the
+        // envelope, then block-wise tracking of the half-bit drift with a
+        // parabolic refinement and a least-squares fit of T. Reads about
+        // 7 points per half-bit instead of number_steps.
+        float coarse_to_fine(const float * msq, int index, int num_points,
+                             float min_val, float max_val, int number_steps);
+
+        // Spectral search: the half-bit boundaries of the envelope produce a
+        // line at 1/T in the spectrum of its edge signal, the squared second
+        // difference (msq[k+1] - 2*msq[k] + msq[k-1])^2.
+        // One real FFT over num_points half-bits (zero-padded 2x to a power of
+        // two) and a Gaussian interpolation of the strongest bin in
+        // [1/max_val, 1/min_val]. The cost depends on the packet length only,
+        // not on the width of the search range.
+        float spectral(const float * msq, int index, int num_points,
+                       float min_val, float max_val, int number_steps);
+
+        // Check a previous estimate T_prev of the same tag: starting from
+        // T_prev, the timing offset of the envelope is measured on blocks of
+        // 16 half-bits ending at num_points/2^k (k decreasing) and T is refit
+        // after each block. If every offset stays inside the search window and
+        // the final period is within tolerance of T_prev, ok = true and that
+        // period is returned; otherwise a full search is needed. Costs
+        // 80 envelope reads per block, i.e. a few hundred per packet.
+        float verify(const float * msq, int index, int num_points,
+                     float min_val, float max_val, int number_steps,
+                     float T_prev, float tolerance, bool & ok);
+
+        // Envelope samples read so far (for profiling)
+        unsigned long reads() const { return d_reads; }
+
+      private:
+        float eval(const float * msq, int index, int num_points, float T);
+        // Timing offset tau (in samples) of half-bits i0..i0+n-1 against the
+        // positions i*T + index: best integer shift in [-max_shift, max_shift]
+        // plus a parabolic refinement. False if the best shift is on the edge.
+        bool block_offset(const float * msq, int index, int i0, int n,
+                          float T, int max_shift, float & tau);
+        static float snap(float T, float min_val, float max_val, int number_steps);
+
+        unsigned long d_reads;
+        std::vector<float> d_energy;
+
+        // FFT plans by size, created on first use
+        std::map<int, std::unique_ptr<gr::fft::fft_real_fwd> > d_fft;
+    };
+
+  } // namespace rfid
+} // namespace gr
+
+#endif /* INCLUDED_RFID_PERIOD_ESTIMATOR_H */
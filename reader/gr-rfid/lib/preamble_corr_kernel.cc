@@ -0,0 +1,191 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "preamble_corr_kernel.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define RFID_HAVE_X86
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RFID_HAVE_NEON
+#endif
+
+namespace gr {
+  namespace rfid {
+
+    void preamble_corr_generic(gr_complex * corr, float * energy,
+                               const gr_complex * in, const float * in_norm,
+                               const int * ones, unsigned int num_ones,
+                               unsigned int num_taps, unsigned int tap_spacing,
+                               unsigned int num_offsets)
+    {
+      for (unsigned int i = 0; i < num_offsets; i++)
+      {
+        gr_complex c = gr_complex(0,0);
+        float e = 0;
+        for (unsigned int k = 0; k < num_ones; k++)
+          c = c + in[i + ones[k] * tap_spacing];
+        for (unsigned int j = 0; j < num_taps; j++)
+          e = e + in_norm[i + j * tap_spacing];
+        corr[i] = c;
+        energy[i] = e;
+      }
+    }
+
+#ifdef RFID_HAVE_X86
+    // 4 offsets per iteration: one float lane per energy, one lane pair per correlation
+    static void preamble_corr_u_sse2(gr_complex * corr, float * energy,
+                                     const gr_complex * in, const float * in_norm,
+                                     const int * ones, unsigned int num_ones,
+                                     unsigned int num_taps, unsigned int tap_spacing,
+                                     unsigned int num_offsets)
+    {
+      const float * in_f = (const float *) in;
+      float * corr_f = (float *) corr;
+      unsigned int i = 0;
+      for (; i + 4 <= num_offsets; i += 4)
+      {
+        __m128 c0 = _mm_setzero_ps();
+        __m128 c1 = _mm_setzero_ps();
+        __m128 e = _mm_setzero_ps();
+        for (unsigned int k = 0; k < num_ones; k++)
+        {
+          const float * p = in_f + 2 * (i + ones[k] * tap_spacing);
+          c0 = _mm_add_ps(c0, _mm_loadu_ps(p));
+          c1 = _mm_add_ps(c1, _mm_loadu_ps(p + 4));
+        }
+        for (unsigned int j = 0; j < num_taps; j++)
+          e = _mm_add_ps(e, _mm_loadu_ps(in_norm + i + j * tap_spacing));
+        _mm_storeu_ps(corr_f + 2 * i, c0);
+        _mm_storeu_ps(corr_f + 2 * i + 4, c1);
+        _mm_storeu_ps(energy + i, e);
+      }
+      preamble_corr_generic(corr + i, energy + i, in + i, in_norm + i, ones, num_ones,
+                            num_taps, tap_spacing, num_offsets - i);
+    }
+
+    // 8 offsets per iteration
+    __attribute__((target("avx")))
+    static void preamble_corr_u_avx(gr_complex * corr, float * energy,
+                                    const gr_complex * in, const float * in_norm,
+                                    const int * ones, unsigned int num_ones,
+                                    unsigned int num_taps, unsigned int tap_spacing,
+                                    unsigned int num_offsets)
+    {
+      const float * in_f = (const float *) in;
+      float * corr_f = (float *) corr;
+      unsigned int i = 0;
+      for (; i + 8 <= num_offsets; i += 8)
+      {
+        __m256 c0 = _mm256_setzero_ps();
+        __m256 c1 = _mm256_setzero_ps();
+        __m256 e = _mm256_setzero_ps();
+        for (unsigned int k = 0; k < num_ones; k++)
+        {
+          const float * p = in_f + 2 * (i + ones[k] * tap_spacing);
+          c0 = _mm256_add_ps(c0, _mm256_loadu_ps(p));
+          c1 = _mm256_add_ps(c1, _mm256_loadu_ps(p + 8));
+        }
+        for (unsigned int j = 0; j < num_taps; j++)
+          e = _mm256_add_ps(e, _mm256_loadu_ps(in_norm + i + j * tap_spacing));
+        _mm256_storeu_ps(corr_f + 2 * i, c0);
+        _mm256_storeu_ps(corr_f + 2 * i + 8, c1);
+        _mm256_storeu_ps(energy + i, e);
+      }
+      preamble_corr_u_sse2(corr + i, energy + i, in + i, in_norm + i, ones, num_ones,
+                           num_taps, tap_spacing, num_offsets - i);
+    }
+#endif
+
+#ifdef RFID_HAVE_NEON
+    // 4 offsets per iteration
+    static void preamble_corr_neon(gr_complex * corr, float * energy,
+                                   const gr_complex * in, const float * in_norm,
+                                   const int * ones, unsigned int num_ones,
+                                   unsigned int num_taps, unsigned int tap_spacing,
+                                   unsigned int num_offsets)
+    {
+      const float * in_f = (const float *) in;
+      float * corr_f = (float *) corr;
+      unsigned int i = 0;
+      for (; i + 4 <= num_offsets; i += 4)
+      {
+        float32x4_t c0 = vdupq_n_f32(0);
+        float32x4_t c1 = vdupq_n_f32(0);
+        float32x4_t e = vdupq_n_f32(0);
+        for (unsigned int k = 0; k < num_ones; k++)
+        {
+          const float * p = in_f + 2 * (i + ones[k] * tap_spacing);
+          c0 = vaddq_f32(c0, vld1q_f32(p));
+          c1 = vaddq_f32(c1, vld1q_f32(p + 4));
+        }
+        for (unsigned int j = 0; j < num_taps; j++)
+          e = vaddq_f32(e, vld1q_f32(in_norm + i + j * tap_spacing));
+        vst1q_f32(corr_f + 2 * i, c0);
+        vst1q_f32(corr_f + 2 * i + 4, c1);
+        vst1q_f32(energy + i, e);
+      }
+      preamble_corr_generic(corr + i, energy + i, in + i, in_norm + i, ones, num_ones,
+                            num_taps, tap_spacing, num_offsets - i);
+    }
+#endif
+
+    static const char * kernel_name = "generic";
+
+    static preamble_corr_kernel_t select_kernel()
+    {
+#ifdef RFID_HAVE_X86
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx"))
+      {
+        kernel_name = "u_avx";
+        return preamble_corr_u_avx;
+      }
+      kernel_name = "u_sse2";
+      return preamble_corr_u_sse2;
+#elif defined(RFID_HAVE_NEON)
+      kernel_name = "neon";
+      return preamble_corr_neon;
+#else
+      return preamble_corr_generic;
+#endif
+    }
+
+    preamble_corr_kernel_t preamble_corr_kernel()
+    {
+      static const preamble_corr_kernel_t kernel = select_kernel();
+      return kernel;
+    }
+
+    const char * preamble_corr_kernel_name()
+    {
+      preamble_corr_kernel();
+      return kernel_name;
+    }
+
+  } /* namespace rfid */
+} /* namespace gr */
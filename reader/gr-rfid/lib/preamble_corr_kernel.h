@@ -0,0 +1,60 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_PREAMBLE_CORR_KERNEL_H
+#define INCLUDED_RFID_PREAMBLE_CORR_KERNEL_H
+
+#include <gnuradio/gr_complex.h>
+
+namespace gr {
+  namespace rfid {
+
+    // VOLK-style kernel for the tag preamble correlation.
+    //
+    // For every offset i < num_offsets:
+    //   corr[i]   = sum over the taps listed in ones[] of in[i + ones[k]*tap_spacing]
+    //   energy[i] = sum_{j < num_taps} in_norm[i + j*tap_spacing]
+    // where in_norm[] holds std::norm(in[]). The SIMD variants work on several
+    // consecutive offsets at once (one lane per offset) and accumulate the taps
+    // in the same order as the scalar loop, so the sums are bit-identical to the
+    // generic version.
+    typedef void (*preamble_corr_kernel_t)(gr_complex * corr, float * energy,
+                                           const gr_complex * in, const float * in_norm,
+                                           const int * ones, unsigned int num_ones,
+                                           unsigned int num_taps, unsigned int tap_spacing,
+                                           unsigned int num_offsets);
+
+    void preamble_corr_generic(gr_complex * corr, float * energy,
+                               const gr_complex * in, const float * in_norm,
+                               const int * ones, unsigned int num_ones,
+                               unsigned int num_taps, unsigned int tap_spacing,
+                               unsigned int num_offsets);
+
+    // Best implementation for the running CPU (AVX, SSE2, NEON or generic),
+    // resolved on first use
+    preamble_corr_kernel_t preamble_corr_kernel();
+
+    // Name of the implementation returned by preamble_corr_kernel()
+    const char * preamble_corr_kernel_name();
+
+  } // namespace rfid
+} // namespace gr
+
+#endif /* INCLUDED_RFID_PREAMBLE_CORR_KERNEL_H */
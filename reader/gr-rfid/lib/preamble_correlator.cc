@@ -0,0 +1,187 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "preamble_correlator.h"
+#include "preamble_corr_kernel.h"
+
+namespace gr {
+  namespace rfid {
+
+    preamble_correlator::preamble_correlator(const int * preamble, int len, int power)
+      : d_len(len), d_power(power)
+    {
+      // Split the ones of the preamble into arithmetic runs (step 1 or 2 taps).
+      // Miller preambles alternate 1,0,1,0 with a few phase flips, so the M8
+      // preamble (48 ones) collapses into 5 runs.
+      for (int j = 0; j < len; j++)
+        if (preamble[j] != 0)
+          d_ones.push_back(j);
+
+      int j = 0;
+      while (j < len)
+      {
+        if (preamble[j] == 0)
+        {
+          j++;
+          continue;
+        }
+        run r;
+        r.first = j;
+        r.count = 1;
+        r.step = 1;
+        if (j + 1 < len && preamble[j + 1] != 0)
+          r.step = 1;
+        else if (j + 2 < len && preamble[j + 2] != 0)
+          r.step = 2;
+        int last = j;
+        while (last + r.step < len && preamble[last + r.step] != 0
+               && (r.step == 1 || preamble[last + 1] == 0))
+        {
+          last += r.step;
+          r.count++;
+        }
+        d_runs.push_back(r);
+        j = last + 1;
+      }
+    }
+
+    preamble_sync_result preamble_correlator::search(const gr_complex * in, int n_offsets, int tap_spacing)
+    {
+      preamble_sync_result res;
+      res.index = 0;
+      res.corr = 0;
+      res.corr2 = gr_complex(0,0);
+      res.last_corr2 = gr_complex(0,0);
+
+      const int span = n_offsets + tap_spacing * (d_len - 1);
+      if (n_offsets <= 0)
+        return res;
+
+      if ((int) d_norm.size() < span)
+        d_norm.resize(span);
+      if ((int) d_corr.size() < n_offsets)
+      {
+        d_corr.resize(n_offsets);
+        d_energy.resize(n_offsets);
+      }
+
+      for (int k = 0; k < span; k++)
+        d_norm[k] = std::norm(in[k]);
+
+      preamble_corr_kernel()(&d_corr[0], &d_energy[0], in, &d_norm[0], &d_ones[0], d_ones.size(),
+                             d_len, tap_spacing, n_offsets);
+
+      float max = 0;
+      for (int i = 0; i < n_offsets; i++)
+      {
+        float corr = std::norm(d_corr[i]) / (d_power * d_energy[i]);
+        if (corr > max)
+        {
+          max = corr;
+          res.index = i;
+          res.corr = corr;
+          res.corr2 = d_corr[i];
+        }
+      }
+      res.last_corr2 = d_corr[n_offsets - 1];
+
+      return res;
+    }
+
+    preamble_sync_result preamble_correlator::search_incremental(const gr_complex * in, int n_offsets, int tap_spacing)
+    {
+      preamble_sync_result res;
+      res.index = 0;
+      res.corr = 0;
+      res.corr2 = gr_complex(0,0);
+      res.last_corr2 = gr_complex(0,0);
+
+      const int d = tap_spacing;
+      const int span = n_offsets + d * (d_len - 1);
+      if (n_offsets <= 0)
+        return res;
+
+      if ((int) d_norm_sum.size() < span)
+      {
+        d_norm_sum.resize(span);
+        d_sum_1.resize(span);
+        d_sum_2.resize(span);
+      }
+
+      // prefix sums along the tap stride
+      for (int k = 0; k < span; k++)
+      {
+        d_norm_sum[k] = std::norm(in[k]);
+        d_sum_1[k] = std::complex<double>(in[k]);
+        d_sum_2[k] = d_sum_1[k];
+        if (k >= d)
+        {
+          d_norm_sum[k] += d_norm_sum[k - d];
+          d_sum_1[k] += d_sum_1[k - d];
+        }
+        if (k >= 2 * d)
+          d_sum_2[k] += d_sum_2[k - 2 * d];
+      }
+
+      float max = 0;
+      for (int i = 0; i < n_offsets; i++)
+      {
+        double cc = d_norm_sum[i + d * (d_len - 1)];
+        if (i >= d)
+          cc -= d_norm_sum[i - d];
+
+        std::complex<double> acc(0,0);
+        for (size_t r = 0; r < d_runs.size(); r++)
+        {
+          const run & ru = d_runs[r];
+          const int first = i + d * ru.first;
+          if (ru.count == 1)
+          {
+            acc += std::complex<double>(in[first]);
+            continue;
+          }
+          const int stride = d * ru.step;
+          const std::vector<std::complex<double> > & sum = (ru.step == 1) ? d_sum_1 : d_sum_2;
+          acc += sum[first + stride * (ru.count - 1)];
+          if (first >= stride)
+            acc -= sum[first - stride];
+        }
+
+        gr_complex corr2 = gr_complex(acc);
+        float corr = std::norm(corr2) / (d_power * (float) cc);
+        if (corr > max)
+        {
+          max = corr;
+          res.index = i;
+          res.corr = corr;
+          res.corr2 = corr2;
+        }
+        res.last_corr2 = corr2;
+      }
+
+      return res;
+    }
+
+  } /* namespace rfid */
+} /* namespace gr */
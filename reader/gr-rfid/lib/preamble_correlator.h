@@ -0,0 +1,93 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_PREAMBLE_CORRELATOR_H
+#define INCLUDED_RFID_PREAMBLE_CORRELATOR_H
+
+#include <gnuradio/gr_complex.h>
+#include <complex>
+#include <vector>
+
+namespace gr {
+  namespace rfid {
+
+    // Outcome of a preamble search over a window of candidate offsets
+    struct preamble_sync_result
+    {
+      int index;              // offset with the highest normalized correlation
+      float corr;             // normalized correlation at index
+      gr_complex corr2;       // raw correlation at index
+      gr_complex last_corr2;  // raw correlation at the last offset searched
+    };
+
+    // Correlator for the tag preamble (used by tag_sync).
+    //
+    // search() evaluates every offset with the SIMD kernel from
+    // preamble_corr_kernel.h and gives bit-identical results to the original
+    // scalar loop.
+    //
+    // search_incremental() is the sliding-window variant. The preamble taps
+    // sit tap_spacing samples apart, so for every offset i the normalizer cc(i) = sum_j norm(in[i + j*tap_spacing]) is a difference
+    // of two entries of a prefix sum taken along that stride. The preamble
+    // itself is a 0/1 sequence made of a handful of arithmetic runs of ones
+    // (step 1 or 2 taps), so the correlation is also a few prefix-sum
+    // differences. The search costs O(window + taps) instead of O(window x taps).
+    // The sums are kept in double, so the results are not bit-identical to
+    // search(): corr and corr2 differ by about 1e-6 relative (last float bits),
+    // which can only change index when two offsets correlate within that.
+    class preamble_correlator
+    {
+      public:
+        preamble_correlator(const int * preamble, int len, int power);
+
+        preamble_sync_result search(const gr_complex * in, int n_offsets, int tap_spacing);
+        preamble_sync_result search_incremental(const gr_complex * in, int n_offsets, int tap_spacing);
+
+        int len() const { return d_len; }
+        int power() const { return d_power; }
+
+      private:
+        struct run
+        {
+          int first;  // first tap of the run
+          int count;  // number of ones in the run
+          int step;   // tap distance between consecutive ones (1 or 2)
+        };
+
+        int d_len;
+        int d_power;
+        std::vector<run> d_runs;
+        std::vector<int> d_ones;  // taps where the preamble is 1
+
+        // scratch for search(), grown on demand
+        std::vector<float> d_norm;
+        std::vector<float> d_energy;
+        std::vector<gr_complex> d_corr;
+
+        // prefix sums along the tap stride (1x and 2x), grown on demand
+        std::vector<double> d_norm_sum;
+        std::vector<std::complex<double> > d_sum_1;
+        std::vector<std::complex<double> > d_sum_2;
+    };
+
+  } // namespace rfid
+} // namespace gr
+
+#endif /* INCLUDED_RFID_PREAMBLE_CORRELATOR_H */
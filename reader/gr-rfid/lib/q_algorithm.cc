@@ -0,0 +1,159 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "q_algorithm.h"
+#include <algorithm>
+#include <cmath>
+
+namespace gr {
+  namespace rfid {
+
+    static const int Q_MAX = 15;
+    // Schoute: expected number of tags in a collided slot of a frame with as
+    // many slots as tags
+    static const float SCHOUTE_TAGS_PER_COLLISION = 2.39;
+
+    q_algorithm::q_algorithm(int initial_q, float c, int mode, float idle_cost)
+      : d_initial_q(std::max(0, std::min(Q_MAX, initial_q))), d_c(c), d_mode(mode), d_idle_cost(idle_cost)
+    {
+      reset();
+    }
+
+    void q_algorithm::reset()
+    {
+      d_q = d_initial_q;
+      d_qfp = d_initial_q;
+      d_updn = Q_UPDN_KEEP;
+      d_slot = 0;
+      d_idle = d_single = d_collision = 0;
+    }
+
+    float q_algorithm::backlog_schoute(int, int, int collision)
+    {
+      return SCHOUTE_TAGS_PER_COLLISION * collision;
+    }
+
+    float q_algorithm::backlog_vogt(int idle, int single, int collision)
+    {
+      const int L = idle + single + collision;
+      if (collision == 0 || L < 2)
+        return SCHOUTE_TAGS_PER_COLLISION * collision;
+
+      // n tags in L slots: E[idle] = L (1 - 1/L)^n, E[single] = n (1 - 1/L)^(n-1)
+      const double log_q = std::log1p(-1.0 / L);
+      const int n_min = single + 2 * collision;
+      int best_n = n_min;
+      double best_d = -1;
+      for (int n = n_min; n <= 2 * n_min; n++)
+      {
+        double p_idle = std::exp(n * log_q);
+        double e_idle = L * p_idle;
+        double e_single = n * p_idle / (1 - 1.0 / L);
+        double e_collision = L - e_idle - e_single;
+        double d = (e_idle - idle) * (e_idle - idle) + (e_single - single) * (e_single - single)
+                 + (e_collision - collision) * (e_collision - collision);
+        if (best_d < 0 || d < best_d)
+        {
+          best_d = d;
+          best_n = n;
+        }
+      }
+      return best_n - single;
+    }
+
+    int q_algorithm::frame_q(float backlog, float idle_cost)
+    {
+      if (backlog <= 1)
+        return 0;
+
+      // time per read of a frame of L slots with n tags: idle slots cost
+      // idle_cost, the others 1, E[single] = n (1 - 1/L)^(n-1)
+      int best_q = 0;
+      double best_cost = -1;
+      for (int q = 0; q <= Q_MAX; q++)
+      {
+        double L = 1 << q;
+        double p_idle = std::pow(1 - 1 / L, backlog);
+        double e_idle = L * p_idle;
+        double e_single = L > 1 ? backlog * p_idle / (1 - 1 / L) : 0;
+        if (e_single <= 0)
+          continue;
+        double cost = (e_idle * idle_cost + (L - e_idle)) / e_single;
+        if (best_cost < 0 || cost < best_cost)
+        {
+          best_cost = cost;
+          best_q = q;
+        }
+      }
+      return best_q;
+    }
+
+    slot_command q_algorithm::end_slot(slot_outcome outcome)
+    {
+      if (outcome == SLOT_IDLE)
+        d_idle++;
+      else if (outcome == SLOT_SINGLE)
+        d_single++;
+      else
+        d_collision++;
+
+      if (d_mode == Q_SELECT_QFP)
+      {
+        if (outcome == SLOT_IDLE)
+          d_qfp = std::max(0.0f, d_qfp - d_c);
+        else if (outcome == SLOT_COLLISION)
+          d_qfp = std::min((float) Q_MAX, d_qfp + d_c);
+
+        // QueryAdjust moves Q by one step, Qfp keeps the rest for later slots
+        int q = (int) std::lround(d_qfp);
+        if (q != d_q)
+        {
+          d_updn = q > d_q ? Q_UPDN_UP : Q_UPDN_DOWN;
+          d_q += q > d_q ? 1 : -1;
+          d_slot = 0;
+          d_idle = d_single = d_collision = 0;
+          return SLOT_CMD_QUERY_ADJUST;
+        }
+      }
+
+      if (++d_slot < round_slots())
+        return SLOT_CMD_QUERY_REP;
+
+      if (d_mode == Q_SELECT_SCHOUTE || d_mode == Q_SELECT_VOGT)
+      {
+        // frame with the shortest expected time per read for the tags left
+        float backlog = d_mode == Q_SELECT_SCHOUTE ? backlog_schoute(d_idle, d_single, d_collision)
+                                                   : backlog_vogt(d_idle, d_single, d_collision);
+        d_q = frame_q(backlog, d_idle_cost);
+        d_qfp = d_q;
+      }
+
+      d_slot = 0;
+      d_idle = d_single = d_collision = 0;
+      return SLOT_CMD_QUERY;
+    }
+
+  } /* namespace rfid */
+} /* namespace gr */
@@ -0,0 +1,95 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_RFID_Q_ALGORITHM_H
+#define INCLUDED_RFID_Q_ALGORITHM_H
+
+#include "rfid/global_vars.h"
+
+namespace gr {
+  namespace rfid {
+
+    enum slot_outcome  {SLOT_IDLE, SLOT_SINGLE, SLOT_COLLISION};
+    enum slot_command  {SLOT_CMD_QUERY, SLOT_CMD_QUERY_REP, SLOT_CMD_QUERY_ADJUST};
+
+    // Indices into Q_UPDN of the QueryAdjust UpDn field
+    const int Q_UPDN_KEEP = 0;    // 000: Q unchanged
+    const int Q_UPDN_DOWN = 3;    // 011: Q = Q - 1
+    const int Q_UPDN_UP   = 6;    // 110: Q = Q + 1
+
+    // Slot-count selection of the inventory rounds (mode: Q_SELECTION_MODE).
+    //   Q_SELECT_FIXED:   Q stays at its initial value, rounds of 2^Q slots.
+    //   Q_SELECT_QFP:     EPC Gen2 Annex D. Qfp is decreased by C after an idle
+    //                     slot and increased by C after a collision. When
+    //                     round(Qfp) differs from Q the round is restarted with
+    //                     a QueryAdjust (Q +/- 1).
+    //   Q_SELECT_SCHOUTE,
+    //   Q_SELECT_VOGT:    Q is kept for the whole round; at its end the tags
+    //                     left are estimated from the idle / single / collision
+    //                     slot counts (Schoute: 2.39 per collision; Vogt: the
+    //                     population whose expected counts are closest to the
+    //                     observed ones, minus the tags read) and the next
+    //                     Query uses the frame size with the shortest expected
+    //                     time per read for that many tags, idle slots being
+    //                     shorter than slots with a reply.
+    // Within a round the next slot is opened with a QueryRep, a new Query
+    // starts a round once all 2^Q slots are used.
+    class q_algorithm
+    {
+      public:
+        // idle_cost: duration of an idle slot relative to a slot with a reply
+        q_algorithm(int initial_q, float c, int mode, float idle_cost = 1);
+
+        void reset();
+
+        // Outcome of the current slot, returns the command opening the next one
+        slot_command end_slot(slot_outcome outcome);
+
+        int q() const { return d_q; }
+        float qfp() const { return d_qfp; }
+        int updn() const { return d_updn; }            // of the last QueryAdjust
+        int slot() const { return d_slot; }            // 0 .. 2^Q - 1
+        int round_slots() const { return 1 << d_q; }
+
+        // Tags left after a round of round_slots slots with the given counts
+        static float backlog_schoute(int /* idle */, int /* single */, int collision);
+        static float backlog_vogt(int idle, int single, int collision);
+        // Q of the frame with the shortest expected time per read for backlog tags
+        static int frame_q(float backlog, float idle_cost);
+
+      private:
+        int d_initial_q;
+        float d_c;
+        int d_mode;
+        float d_idle_cost;
+
+        int d_q;
+        float d_qfp;
+        int d_updn;
+        int d_slot;
+        // slot counts of the current round
+        int d_idle, d_single, d_collision;
+    };
+
+  } // namespace rfid
+} // namespace gr
+
+#endif /* INCLUDED_RFID_Q_ALGORITHM_H */
@@ -0,0 +1,459 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "rate_controller.h"
+
+namespace gr {
+  namespace rfid {
+
+    // MobiRate velocity estimate
+    static const float PI = 3.14159;
+    static const float WAVLEN = 30000.0 / (915 * 4 * PI);
+
+    void rate_controller::add_note(const char * text)
+    {
+      if (d_num_notes == MAX_NOTES)
+        return;
+      d_notes[d_num_notes].text = text;
+      d_notes[d_num_notes].value = 0;
+      d_notes[d_num_notes].has_value = false;
+      d_num_notes++;
+    }
+
+    void rate_controller::add_note(const char * text, float value)
+    {
+      if (d_num_notes == MAX_NOTES)
+        return;
+      d_notes[d_num_notes].text = text;
+      d_notes[d_num_notes].value = value;
+      d_notes[d_num_notes].has_value = true;
+      d_num_notes++;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////
+    // Fixed rate: keep the rate the reader is configured with
+    class fixed_rate_controller : public rate_controller
+    {
+      public:
+        const char * name() const { return "fixed"; }
+        void on_slot_result(const rate_observation &) {}
+        int select_next(const rate_observation & obs) { return obs.rate; }
+    };
+
+    /////////////////////////////////////////////////////////////////////////////////////////
+    // Auto Rate Fallback: one step down after arf_down (2) successive
+    // failures or 1 failure right after stepping up, one step up after
+    // arf_up (3) successes.
+    class arf_rate_controller : public rate_controller
+    {
+      public:
+        arf_rate_controller(int initial_rate, const rate_controller_params & p)
+          : d_p(p), d_rate(initial_rate), d_last(-1), d_n_success(0), d_n_failure(0), d_just_elevated(false)
+        {
+        }
+
+        const char * name() const { return "arf"; }
+
+        void on_slot_result(const rate_observation & obs)
+        {
+          if (!obs.valid)
+            return;
+
+          // consecutive transmission counts
+          if (obs.success)
+          {
+            d_n_success = d_last == 1 ? d_n_success + 1 : 1;
+            d_n_failure = 0;
+          }
+          else
+          {
+            d_n_failure = d_last == 0 ? d_n_failure + 1 : 1;
+            d_n_success = 0;
+          }
+          d_last = obs.success;
+
+          if (d_just_elevated && obs.success)
+            d_just_elevated = false;
+
+          if (d_n_failure == d_p.arf_down || (d_n_failure == 1 && d_just_elevated))
+          {
+            d_n_success = 0;
+            d_n_failure = 0;
+            d_just_elevated = false;
+            if (d_rate > 0)
+            {
+              d_rate--;
+              add_note("adjust to ", RATE_M[d_rate]);
+            }
+          }
+          if (d_n_success == d_p.arf_up)
+          {
+            d_n_success = 0;
+            d_n_failure = 0;
+            if (d_rate < NUM_RATES - 1)
+            {
+              d_just_elevated = true;
+              d_rate++;
+              add_note("adjust to ", RATE_M[d_rate]);
+            }
+          }
+        }
+
+        int select_next(const rate_observation &) { return d_rate; }
+
+      private:
+        const rate_controller_params d_p;
+        int d_rate;
+        int d_last;           // -1 before the first valid slot
+        int d_n_success, d_n_failure;
+        bool d_just_elevated;
+    };
+
+    /////////////////////////////////////////////////////////////////////////////////////////
+    // Minstrel: periodically probes every rate (FM0 first) and keeps an EMA
+    // of the successes of each; in between it dwells on the rate with the
+    // best successes per tag bit duration.
+    class minstrel_rate_controller : public rate_controller
+    {
+      public:
+        minstrel_rate_controller(int initial_rate, const rate_controller_params & p)
+          : d_p(p), d_rate(initial_rate), d_mode(-1), d_probing_rate(NUM_RATES - 1), d_n_success(0),
+            d_timer(0), d_dwelling_start(0), d_last_success(false)
+        {
+          for (int i = 0; i < NUM_RATES; i++)
+            d_pktloss_table[i] = 0;
+        }
+
+        const char * name() const { return "minstrel"; }
+
+        void on_slot_result(const rate_observation & obs)
+        {
+          d_last_success = obs.valid && obs.success;
+        }
+
+        int select_next(const rate_observation & obs)
+        {
+          if (d_mode == -1)
+          {
+            d_timer = obs.t;
+            d_mode = 1;
+          }
+          if (d_mode == 1)
+          {
+            d_n_success += d_last_success;
+            double interval = obs.t - d_timer;
+            // end probing & adjust rate
+            if (interval > 0.5 * d_p.minstrel_probe_s && d_probing_rate == 0)
+            {
+              d_pktloss_table[d_probing_rate] = 0.25 * d_pktloss_table[d_probing_rate] + 0.75 * d_n_success;
+              d_mode = 0;
+              d_probing_rate = NUM_RATES - 1;
+              float max_tp = 0;
+              for (int i = 0; i < NUM_RATES - 1; i++)
+              {
+                if (d_pktloss_table[i] / RATE_M[i] > max_tp)
+                {
+                  max_tp = d_pktloss_table[i] / RATE_M[i];
+                  d_rate = i;
+                }
+              }
+              d_dwelling_start = obs.t;
+            }
+            // probing end of one rate: summarize it and switch to the next
+            else
+            {
+              if (interval > d_p.minstrel_probe_s)
+              {
+                d_pktloss_table[d_probing_rate] = 0.25 * d_pktloss_table[d_probing_rate] + 0.75 * d_n_success / 3;
+                d_probing_rate--;
+                d_timer = obs.t;
+                d_n_success = 0;
+              }
+              d_rate = d_probing_rate;
+            }
+          }
+          // keep current rate until timeout (d_dwelling_start is only set
+          // once a probing round has ended)
+          if (d_mode == 0 && obs.t - d_dwelling_start > d_p.minstrel_dwell_s)
+            d_mode = -1;
+          return d_rate;
+        }
+
+      private:
+        const rate_controller_params d_p;
+        int d_rate;
+        int d_mode;           // -1: start probing, 1: probing, 0: dwelling
+        int d_probing_rate;
+        int d_n_success;
+        double d_timer, d_dwelling_start;
+        float d_pktloss_table[NUM_RATES];
+        bool d_last_success;
+    };
+
+    /////////////////////////////////////////////////////////////////////////////////////////
+    // BLINK: two scans compare RSSI and packet loss; a change above the
+    // thresholds triggers a probe at Miller-8, then the reader returns to FM0.
+    class blink_rate_controller : public rate_controller
+    {
+      public:
+        blink_rate_controller(int initial_rate, const rate_controller_params & p)
+          : d_p(p), d_rate(initial_rate), d_mode(0), d_scan_cnt(1), d_scan_start(true), d_timer(0),
+            d_queries(0), d_n_success(1E-4),
+            d_pktloss_firstscan(0), d_pktloss_secondscan(0), d_RSSI_firstscan(0), d_RSSI_secondscan(0),
+            d_pktloss_probe(0), d_RSSI_probe(0)
+        {
+        }
+
+        const char * name() const { return "blink"; }
+
+        void on_slot_result(const rate_observation & obs)
+        {
+          d_queries++;
+          if (obs.valid && obs.success)
+            d_n_success += 1;
+        }
+
+        int select_next(const rate_observation & obs)
+        {
+          if (d_mode == 0) // IDLE
+          {
+            if (d_scan_cnt == 1 || d_scan_cnt == 2) // first / second scan
+            {
+              const bool first = d_scan_cnt == 1;
+              if (d_scan_start)
+              {
+                add_note(first ? "first scan start" : "second scan start");
+                start_scan(obs.t);
+              }
+              if (obs.t - d_timer > d_p.blink_scan_s)
+              {
+                add_note(first ? "first scan end" : "second scan end");
+                // summarize pktloss & RSSI
+                (first ? d_pktloss_firstscan : d_pktloss_secondscan) = d_n_success / d_queries;
+                (first ? d_RSSI_firstscan : d_RSSI_secondscan) = obs.rssi;
+                d_scan_cnt = first ? 2 : 0;
+                d_scan_start = true;
+              }
+            }
+            else // both scans done: trigger
+            {
+              float diff_RSSI = (d_RSSI_secondscan - d_RSSI_firstscan) * (d_RSSI_secondscan - d_RSSI_firstscan);
+              float diff_pktloss = (d_pktloss_secondscan - d_pktloss_firstscan) * (d_pktloss_secondscan - d_pktloss_firstscan);
+              add_note("dRSSI : ", diff_RSSI);
+              add_note("dpktloss : ", diff_pktloss);
+              if (diff_RSSI > d_p.blink_th_rssi || diff_pktloss > d_p.blink_th_pktloss)
+              {
+                d_mode = 1; // probing triggered
+                d_rate = 0;
+                add_note("probing triggered");
+              }
+              d_scan_cnt = 1;
+            }
+          }
+          else // PROBING at Miller-8
+          {
+            if (d_scan_start)
+            {
+              d_rate = 0;
+              start_scan(obs.t);
+            }
+            if (obs.t - d_timer > d_p.blink_probe_s)
+            {
+              // summarize pktloss & RSSI
+              d_pktloss_probe = d_n_success / d_queries;
+              d_RSSI_probe = obs.rssi;
+
+              // map link signature to optimal rate
+              // To do ...
+              d_rate = NUM_RATES - 1;
+              d_scan_start = true;
+              d_mode = 0;
+            }
+          }
+          return d_rate;
+        }
+
+      private:
+        void start_scan(double t)
+        {
+          d_queries = 0;
+          d_timer = t;
+          d_scan_start = false;
+          d_n_success = 1E-4;
+        }
+
+        const rate_controller_params d_p;
+        int d_rate;
+        int d_mode;           // 0: IDLE, 1: PROBING
+        int d_scan_cnt;
+        bool d_scan_start;
+        double d_timer;
+        int d_queries;
+        float d_n_success;
+        float d_pktloss_firstscan, d_pktloss_secondscan;
+        float d_RSSI_firstscan, d_RSSI_secondscan;
+        float d_pktloss_probe, d_RSSI_probe;
+    };
+
+    /////////////////////////////////////////////////////////////////////////////////////////
+    // MobiRate: Minstrel/SampleRate with a mobility-aware EMA. The phase
+    // change of the tag replies gives a velocity estimate that sets the EMA
+    // coefficient.
+    class mobirate_rate_controller : public rate_controller
+    {
+      public:
+        mobirate_rate_controller(int initial_rate)
+          : d_rate(initial_rate), d_mode(0), d_lambda(0.07), d_timer1(0), d_timer2(0), d_started(false),
+            d_phase_realtime(0), d_phase_scan_cnt(0), d_n_failure(0), d_valid(false), d_success(false)
+        {
+          for (int i = 0; i < NUM_RATES; i++)
+            d_pktloss_table[i] = 0;
+        }
+
+        const char * name() const { return "mobirate"; }
+
+        void on_slot_result(const rate_observation & obs)
+        {
+          d_valid = obs.valid;
+          d_success = obs.success;
+        }
+
+        int select_next(const rate_observation & obs)
+        {
+          // the keep timer runs from the first Query, whatever the clock's epoch
+          if (!d_started)
+          {
+            d_timer2 = obs.t;
+            d_started = true;
+          }
+
+          if (d_valid)
+          {
+            // monitor phase changes to estimate mobility and set lambda
+            if (d_phase_scan_cnt == 0) // first phase
+            {
+              d_phase_realtime = obs.phase;
+              d_phase_scan_cnt = 1;
+              d_timer1 = obs.t;
+            }
+            double interval = obs.t - d_timer1;
+            if (d_phase_scan_cnt == 1 && interval > 0.2) // second scan
+            {
+              // unwrap phase
+              float diff_phase = obs.phase - d_phase_realtime;
+              if (diff_phase > PI)
+                diff_phase -= 2 * PI;
+              else if (diff_phase < -PI)
+                diff_phase += 2 * PI;
+              // estimate velocity
+              float v_est = WAVLEN * diff_phase / interval; // v = xx cm/s
+              if (v_est < 0.01)
+                d_lambda = 0.07;
+              else if (v_est < 0.8)
+                d_lambda = 0.28;
+              else
+                d_lambda = 0.39;
+              d_phase_scan_cnt = 0;
+            }
+          }
+
+          const float s = (d_valid && d_success) ? 1 : 0;
+          if (d_mode == 1 || d_mode == 2) // probe higher / lower rate
+          {
+            d_pktloss_table[d_rate] = d_lambda * d_pktloss_table[d_rate] + (1 - d_lambda) * s;
+            if (obs.t - d_timer2 > 2)
+            {
+              const int original = d_mode == 1 ? d_rate - 1 : d_rate + 1;
+              if (d_pktloss_table[d_rate] - d_pktloss_table[original] < 0)
+              {
+                d_rate = original;
+                add_note("keep original rate");
+              }
+              add_note(d_mode == 1 ? "end probing higher rate" : "end probing lower rate");
+              d_mode = 0; // back to keep mode
+              d_timer2 = obs.t; // reset timer for keep mode
+            }
+          }
+          else // keep
+          {
+            if (d_success && d_valid)
+              d_n_failure = 0;
+            d_n_failure += (d_valid && !d_success);
+            if (d_rate > 0 && d_n_failure >= 2)
+            {
+              d_n_failure = 0;
+              d_timer2 = obs.t; // start timer for probing
+              d_rate--;
+              d_mode = 2;
+              add_note("probe lower rate");
+            }
+            else if (d_rate < NUM_RATES - 1 && obs.t - d_timer2 > 2)
+            {
+              d_n_failure = 0;
+              d_timer2 = obs.t; // start timer for probing
+              d_rate++;
+              d_mode = 1;
+              add_note("probe higher rate");
+            }
+            else // record packetloss of current rate
+            {
+              d_pktloss_table[d_rate] = d_lambda * d_pktloss_table[d_rate] + (1 - d_lambda) * s;
+            }
+          }
+          return d_rate;
+        }
+
+      private:
+        int d_rate;
+        int d_mode;           // 0: KEEP, 1: HIGHER, 2: LOWER
+        float d_lambda;       // exponential coefficient
+        double d_timer1, d_timer2;
+        bool d_started;
+        float d_phase_realtime;
+        int d_phase_scan_cnt;
+        int d_n_failure;
+        float d_pktloss_table[NUM_RATES];
+        bool d_valid, d_success;
+    };
+
+    std::unique_ptr<rate_controller> make_rate_controller(const std::string & name, int initial_rate,
+                                                          const rate_controller_params & params)
+    {
+      std::unique_ptr<rate_controller> c;
+      if (name == "fixed")
+        c.reset(new fixed_rate_controller());
+      else if (name == "arf")
+        c.reset(new arf_rate_controller(initial_rate, params));
+      else if (name == "minstrel")
+        c.reset(new minstrel_rate_controller(initial_rate, params));
+      else if (name == "blink")
+        c.reset(new blink_rate_controller(initial_rate, params));
+      else if (name == "mobirate")
+        c.reset(new mobirate_rate_controller(initial_rate));
+      return c;
+    }
+
+  } /* namespace rfid */
+} /* namespace gr */
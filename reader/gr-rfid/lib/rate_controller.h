@@ -0,0 +1,114 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_RFID_RATE_CONTROLLER_H
+#define INCLUDED_RFID_RATE_CONTROLLER_H
+
+#include <memory>
+#include <string>
+
+namespace gr {
+  namespace rfid {
+
+    // Tag encodings the rate controllers choose from, in the order of
+    // index_ES_LIST: 0 = Miller-8 (slowest, most robust) ... 3 = FM0
+    const int NUM_RATES = 4;
+    const int RATE_M[NUM_RATES] = {8, 4, 2, 1};
+
+    // What the reader saw since the previous Query. Plain values only, so
+    // the controllers also run outside of a flowgraph (trace replay).
+    struct rate_observation
+    {
+      double t;         // time in seconds, any origin (the reader counts from its start)
+      int rate;         // rate the last Query was sent with
+      bool valid;       // an RN16 was decoded, so the slot carried an EPC attempt
+      bool success;     // the EPC was received with a correct CRC
+      float rssi;       // running RSSI of the tag replies (dB)
+      float phase;      // channel phase of the last reply (rad)
+    };
+
+    // Tunable thresholds of the policies (defaults are the values the
+    // reader has always used), so offline sweeps need no rebuild
+    struct rate_controller_params
+    {
+      float blink_th_rssi = 0.20;      // BLINK: squared RSSI change that triggers probing
+      float blink_th_pktloss = 0.15;   // BLINK: squared packet loss change that triggers probing
+      float blink_scan_s = 2.0;        // BLINK: duration of each scan
+      float blink_probe_s = 5.0;       // BLINK: duration of the probe
+      float minstrel_probe_s = 2.0;    // Minstrel: time spent probing each rate
+      float minstrel_dwell_s = 3.0;    // Minstrel: time between probing rounds
+      int arf_up = 3;                  // ARF: successes before stepping up
+      int arf_down = 2;                // ARF: failures before stepping down
+    };
+
+    // Something a controller wants logged about its last decision
+    struct rate_note
+    {
+      const char * text;
+      float value;
+      bool has_value;
+    };
+
+    // Rate adaptation policy. The reader calls on_slot_result() and then
+    // select_next() once per Query; both are O(1) with state owned by the
+    // controller.
+    class rate_controller
+    {
+      public:
+        static const int MAX_NOTES = 4;
+
+        virtual ~rate_controller() {}
+
+        virtual const char * name() const = 0;
+
+        // Outcome of the slot that followed the previous Query
+        virtual void on_slot_result(const rate_observation & obs) = 0;
+
+        // Rate (index into RATE_M) for the next Query
+        virtual int select_next(const rate_observation & obs) = 0;
+
+        // Notes of the last on_slot_result()/select_next() pair, cleared
+        // by the caller with clear_notes()
+        int num_notes() const { return d_num_notes; }
+        const rate_note & note(int i) const { return d_notes[i]; }
+        void clear_notes() { d_num_notes = 0; }
+
+      protected:
+        rate_controller() : d_num_notes(0) {}
+
+        void add_note(const char * text);
+        void add_note(const char * text, float value);
+
+      private:
+        rate_note d_notes[MAX_NOTES];
+        int d_num_notes;
+    };
+
+    // Policies by name: "fixed", "arf" (Auto Rate Fallback), "minstrel",
+    // "blink" and "mobirate". initial_rate is the rate the reader starts
+    // with. Returns an empty pointer for an unknown name.
+    std::unique_ptr<rate_controller> make_rate_controller(const std::string & name, int initial_rate,
+                                                          const rate_controller_params & params = rate_controller_params());
+
+  } // namespace rfid
+} // namespace gr
+
+#endif /* INCLUDED_RFID_RATE_CONTROLLER_H */
@@ -26,6 +26,13 @@
 #include "reader_impl.h"
 #include "rfid/global_vars.h"
 #include "tag_decoder_impl.h"
+#include "gen2_crc.h"
+#include "alloc_guard.h"
+#include "async_log.h"
+#include "adabs_rate_controller.h"
+#include "run_metrics.h"
+#include <volk/volk.h>
+#include <chrono>
 #include <sys/time.h>
 #include<iomanip>
 #include <bitset>
@@ -36,22 +43,41 @@ namespace gr {
   namespace rfid {
 
     reader::sptr
-    reader::make(int sample_rate, int dac_rate)
+    reader::make(int sample_rate, int dac_rate, const std::string & rate_policy, bool complex_output)
     {
       return gnuradio::get_initial_sptr
-        (new reader_impl(sample_rate,dac_rate));
+        (new reader_impl(sample_rate,dac_rate,rate_policy,complex_output));
+    }
+
+    // Policy used when reader::make gets no name: the compile-time flags
+    static const char * default_rate_policy()
+    {
+      if (ADABS_EN == 1)
+        return "adabs";
+      if (MobiRate_EN == 1)
+        return "mobirate";
+      if (AUTO_RATE_FALLBACK_EN == 1)
+        return "arf";
+      if (MINSTREL_EN == 1)
+        return "minstrel";
+      if (BLINK_EN == 1 && FIXED_RATE_EN == 0)
+        return "blink";
+      return "fixed";
     }
 
     /*
      * The private constructor
      */
-    reader_impl::reader_impl(int sample_rate, int dac_rate)
+    reader_impl::reader_impl(int sample_rate, int dac_rate, const std::string & rate_policy, bool complex_output)
       : gr::block("reader",
               gr::io_signature::make( 1, 1, sizeof(float)),
-              gr::io_signature::make( 1, 1, sizeof(float)))
+              gr::io_signature::make( 1, 1, complex_output ? sizeof(gr_complex) : sizeof(float))),
+        d_complex_output(complex_output),
+        rate_decisions(0), rate_decision_ns(0), rate_decision_ns_max(0),
+        rate_t0(std::chrono::steady_clock::now()),
+        d_idle_waits(0), d_idle_timeouts(0)
     {
       //message_port_register_out(pmt::mp("reader_command"));
-      command_bits = (char *) malloc( sizeof(char) * 24);
       sample_d = 1.0/dac_rate * pow(10,6);
 
       // Number of samples for transmitting
@@ -63,26 +89,38 @@ namespace gr {
       n_trcal_s = TRCAL_D / sample_d;
 
       // CW waveforms of different sizes
-      n_cwquery_s   = (T1_D+T2_D+RN16_D)/sample_d;     //RN16 ---
-      n_cwack_s     = (1*T1_D+T2_D+EPC_D)/sample_d;    //EPC   if it is longer than nominal it wont cause tags to change inventoried flag ---
       n_cwreq_s   = (T1_D+T2_D+HANDLE_D)/sample_d;     //Handle or new rn16
       n_cwread_s   = (T1_D+T2_D+READ_D)/sample_d;     //READ
       n_p_down_s     = (1*P_DOWN_D)/sample_d;  
 
       p_down.resize(n_p_down_s);        // Power down samples
-      cw_query.resize(n_cwquery_s);      // Sent after query/query rep ---
-      cw_ack.resize(n_cwack_s);          // Sent after ack ---
       cw_start.resize(n_cw_s);          // Sent after start
       cw_req_rn16.resize(n_cwreq_s);          // Sent after Req_RN16
       cw_read.resize(n_cwread_s);          // Sent after READ
 
 
-      std::fill_n(cw_query.begin(), cw_query.size(), 1); // ---
-      std::fill_n(cw_ack.begin(), cw_ack.size(), 1); // ---
       std::fill_n(cw_start.begin(), cw_start.size(), 1);
       std::fill_n(cw_req_rn16.begin(), cw_req_rn16.size(), 1);
       std::fill_n(cw_read.begin(), cw_read.size(), 1);
 
+      // Link timing and CW after Query/ACK of every encoding, in index_ES_LIST
+      // order. The globals keep their initial values until the first switch.
+      for (int i = 0; i < 4; i++)
+        link_profiles[i].init(index_ES_LIST[i], sample_d);
+      link = &link_profiles[link_profile_index(ENCODING_SCHEME)];
+
+      std::string policy = rate_policy.empty() ? default_rate_policy() : rate_policy;
+      if (policy == "adabs")
+        rate.reset(new adabs_rate_controller(index_ES));
+      else
+        rate = make_rate_controller(policy, index_ES);
+      if (!rate)
+      {
+        std::cout << "Unknown rate policy '" << policy << "', using fixed rate" << std::endl;
+        rate = make_rate_controller("fixed", index_ES);
+      }
+      std::cout << "Rate policy : " << rate->name() << std::endl;
+
       // Construct vectors (resize() default initialization is zero)
       data_0.resize(n_data0_s);
       data_1.resize(n_data1_s);
@@ -127,16 +165,63 @@ namespace gr {
       nak.insert( nak.end(), data_0.begin(), data_0.end() );
       nak.insert( nak.end(), data_0.begin(), data_0.end() );
 
-
-
+      // Render every Query variant (M, Target, Q) once; the other fields
+      // are constants
+      commands.init(data_0, data_1, preamble);
+      for (int m = 0; m < 4; m++)
+        for (int target = 0; target < 2; target++)
+          for (int q = 0; q < 16; q++)
+          {
+            bit_buffer body;
+            body.append(QUERY_CODE, 4);
+            body.push_back(DR);
+            body.append(link_profiles[m].m_field, 2);
+            body.push_back(TREXT);
+            body.append(SEL, 2);
+            body.append(SESSION, 2);
+            body.push_back(target);
+            body.append(Q_VALUE[q], 4);
+            commands.query(body);
+          }
+
+      // Constant prefixes of the commands carrying an RN16 or handle
+      bit_buffer bits;
+      bits.append(ACK_CODE, 2);
+      ack_prefix = frame_sync;
+      commands.append(ack_prefix, bits);
+
+      bits.clear();
+      bits.append(REQ_RN16_CODE, 8);
+      req_rn16_prefix = frame_sync;
+      commands.append(req_rn16_prefix, bits);
+
+      bits.clear();
+      bits.append(READ_CODE, 8);
+      bits.append(MemBank, 2);
+      bits.append(WordPtr, 8);
+      bits.append(Wordcount, 8);
+      read_prefix = frame_sync;
+      commands.append(read_prefix, bits);
+
+      // QueryAdjust, one waveform per Q_UPDN entry
+      query_adjust.resize(7);
+      for (int u = 0; u < 7; u++)
+      {
+        bits.clear();
+        bits.append(QADJ_CODE, 4);
+        bits.append(SESSION, 2);
+        bits.append(Q_UPDN[u], 3);
+        query_adjust[u] = frame_sync;
+        commands.append(query_adjust[u], bits);
+      }
     }
 
     void reader_impl::gen_query_bits()
     {
       int num_ones = 0, num_zeros = 0;
 
-      query_bits.resize(0);
-      query_bits.insert(query_bits.end(), &QUERY_CODE[0], &QUERY_CODE[4]);
+      query_bits.clear();
+      query_bits.append(QUERY_CODE, 4);
       query_bits.push_back(DR);
       /*
       if (cnt_queries > 2000 && cnt_queries < 4000) {
@@ -146,151 +231,11 @@ namespace gr {
         adabs_nn_en = 0;
       }
       */
-      /////////////////////////////////////////////////////////////////////////////////////////
-      // ADABS RATE ADAPTATION (my own algorithm)
-      /////////////////////////////////////////////////////////////////////////////////////////
-      if (ADABS_EN == 1) {
-        if (THROUGHPUT_MONITOR_EN == 1 && THROUGHPUT_AVAILABLE == 1) {
-          //cout << "\n---tp reading available once---" << endl;
-          //float goodput_monitored = pow(pktCorrectRatio, bulky_N - 1) * tp_now;
-          goodput_monitored = throughput_monitored;
-          cnt_loss_epc = 0;
-          cnt_tp_monitored = 0;
-          throughput_monitored = 0;
-          cout << "tp monitored : " << goodput_monitored << endl;
-          float P_Tx = E_Tx / accumulative_d_monitor;
-          //std::cout << "BpJ (kbits/J) : " << 0.32 * retran_goodput_pkt_cnt / total_time / P_Tx << std::endl;
-          //tp_record.push_back(goodput_monitored);
-          //t_record.push_back(total_time);
-          if (goodput_monitored < TP_LOWER_LIMIT || goodput_monitored > TP_UPPER_LIMIT) {
-            // prepare for probing
-            ADABS_PROBING_MODE = 1;
-            // FM0 & AMP = 1 for probing
-            index_ES = 3;
-            rta_ampl = 0.7 * 1;
-            
-            THROUGHPUT_MONITOR_EN = 0; // when to enable?
-            THROUGHPUT_AVAILABLE = 0;
-            ADABS_PROBING_DONE = 0;
-            RSSI = 1E-10;
-            NoiseI = 1E-10;
-            cnt_NoiseI = 1;
-            cnt_RSSI = 1;
-            cout << "\n---start probing---" << endl;
-            //cout << "---tp monitor is off---\n" << endl;
-          }
-          THROUGHPUT_AVAILABLE = 0;
-        }
-        if (ADABS_PROBING_MODE == 1 && ADABS_PROBING_DONE == 1) { // (powerup-delay is ready)
-          // call DNN
-          adabs_nn_en = 1; // it should be set 0 by dnn after inference
-          //cout << "\n---end probing---\n" << endl;
-        }
-        if (INFERENCE_RESULTS_AVAILABLE == 1) { // DNN inference is done
-          // adjust transmission parameters
-          
-          rta_ampl = 0.7 * amp_inference;
-          index_ES = 3 - es_inference;
-          
-          if (ADABS_PROBING_DONE == 1) { // if next power-up delay is available, tp monitor will be enabled again (ADABS_PROBING_DONE == 1?)
-            INFERENCE_RESULTS_AVAILABLE = 0;
-            THROUGHPUT_MONITOR_EN = 1;
-            //cout << "\n---tp monitor is on---\n" << endl;
-          }
-        }
-        
-        ENCODING_SCHEME = index_ES_LIST[index_ES];
-        if (ENCODING_SCHEME == 1)
-        {
-          query_bits.insert(query_bits.end(), &M_FM0[0], &M_FM0[2]);
-          bulky_N = 3;
-        }
-        else if (ENCODING_SCHEME == 2)
-        {
-          query_bits.insert(query_bits.end(), &M_Miller2[0], &M_Miller2[2]);
-          bulky_N = 2;
-        }
-        else if (ENCODING_SCHEME == 4)
-        {
-          query_bits.insert(query_bits.end(), &M_Miller4[0], &M_Miller4[2]);
-          bulky_N = 1;
-        }
-        else
-        {
-          query_bits.insert(query_bits.end(), &M_Miller8[0], &M_Miller8[2]);
-          bulky_N = 1;
-        }
-        // adjust other params
-        TAG_BIT_D   = 1.0 * ENCODING_SCHEME/T_READER_FREQ * pow(10,6); // Duration in us
-        RN16_D      = (RN16_BITS + TAG_PREAMBLE_BITS) * TAG_BIT_D;
-        EPC_D         = (EPC_BITS  + TAG_PREAMBLE_BITS) * TAG_BIT_D;
-        HANDLE_D = (RN16_BITS - 1  + TAG_PREAMBLE_BITS + 16) * TAG_BIT_D; // RN16 without? dummy-bit  
-        READ_D = (1 + 32+ 16 + 16+ TAG_PREAMBLE_BITS ) * TAG_BIT_D; // RN16 without? dummy-bit
-    
-        Tsk = T1_D + RN16_D + T2_D + Tack + T1_D + EPC_D + T2_D;  //Duration of single/collision slot in us
-        Ti  = T1_D + RN16_D + T2_D; //Duration of idle slot in us
-    
-        C_th = C_th_LIST[ENCODING_SCHEME];
-
-        n_cwquery_s   = (T1_D+T2_D+RN16_D)/sample_d;     //RN16 ---
-        n_cwack_s     = (1*T1_D+T2_D+EPC_D)/sample_d;    //EPC   if it is longer than nominal it wont cause tags to change inventoried flag ---
-
-        std::vector<float>().swap(cw_query);
-        std::vector<float>().swap(cw_ack);
-
-        cw_query.resize(n_cwquery_s);      // Sent after query/query rep ---
-        cw_ack.resize(n_cwack_s);          // Sent after ack ---
-
-        std::fill_n(cw_query.begin(), cw_query.size(), 1); // ---
-        std::fill_n(cw_ack.begin(), cw_ack.size(), 1); // ---
-        valid_packet = 0;
-
-      }
-      
       ////////////////////////////////////////////////////////////////////////////////////////
       // Only for data collection
       ////////////////////////////////////////////////////////////////////////////////////////
       if (RFID_LOCALIZATION == 1) {
         ENCODING_SCHEME = 1;
-        if (ENCODING_SCHEME == 1)
-        {
-          query_bits.insert(query_bits.end(), &M_FM0[0], &M_FM0[2]);
-        }
-        else if (ENCODING_SCHEME == 2)
-        {
-          query_bits.insert(query_bits.end(), &M_Miller2[0], &M_Miller2[2]);
-        }
-        else if (ENCODING_SCHEME == 4)
-        {
-          query_bits.insert(query_bits.end(), &M_Miller4[0], &M_Miller4[2]);
-        }
-        else
-        {
-          query_bits.insert(query_bits.end(), &M_Miller8[0], &M_Miller8[2]);
-        }
-        // adjust other params
-        TAG_BIT_D   = 1.0 * ENCODING_SCHEME/T_READER_FREQ * pow(10,6); // Duration in us
-        RN16_D      = (RN16_BITS + TAG_PREAMBLE_BITS) * TAG_BIT_D;
-        EPC_D         = (EPC_BITS  + TAG_PREAMBLE_BITS) * TAG_BIT_D;
-        HANDLE_D = (RN16_BITS - 1  + TAG_PREAMBLE_BITS + 16) * TAG_BIT_D; // RN16 without? dummy-bit  
-        READ_D = (1 + 32+ 16 + 16+ TAG_PREAMBLE_BITS ) * TAG_BIT_D; // RN16 without? dummy-bit
-    
-        Tsk = T1_D + RN16_D + T2_D + Tack + T1_D + EPC_D + T2_D;  //Duration of single/collision slot in us
-        Ti  = T1_D + RN16_D + T2_D; //Duration of idle slot in us
-    
-        C_th = C_th_LIST[ENCODING_SCHEME];
-
-        n_cwquery_s   = (T1_D+T2_D+RN16_D)/sample_d;     //RN16 ---
-        n_cwack_s     = (1*T1_D+T2_D+EPC_D)/sample_d;    //EPC   if it is longer than nominal it wont cause tags to change inventoried flag ---
-
-        std::vector<float>().swap(cw_query);
-        std::vector<float>().swap(cw_ack);
-
-        cw_query.resize(n_cwquery_s);      // Sent after query/query rep ---
-        cw_ack.resize(n_cwack_s);          // Sent after ack ---
-
-        std::fill_n(cw_query.begin(), cw_query.size(), 1); // ---
-        std::fill_n(cw_ack.begin(), cw_ack.size(), 1); // ---
         valid_packet = 0;
       }
       
@@ -402,45 +347,6 @@ namespace gr {
           //adabs_lossrate_table[3] = (cnt_loss_epc + 1e-5) / (cnt_loss_epc + reader_state->reader_stats.n_epc_correct + 1e-5); // record M8 lossrate
         }
 
-        if (ENCODING_SCHEME == 1)
-        {
-          query_bits.insert(query_bits.end(), &M_FM0[0], &M_FM0[2]);
-        }
-        else if (ENCODING_SCHEME == 2)
-        {
-          query_bits.insert(query_bits.end(), &M_Miller2[0], &M_Miller2[2]);
-        }
-        else if (ENCODING_SCHEME == 4)
-        {
-          query_bits.insert(query_bits.end(), &M_Miller4[0], &M_Miller4[2]);
-        }
-        else
-        {
-          query_bits.insert(query_bits.end(), &M_Miller8[0], &M_Miller8[2]);
-        }
-        // adjust other params
-        TAG_BIT_D   = 1.0 * ENCODING_SCHEME/T_READER_FREQ * pow(10,6); // Duration in us
-        RN16_D      = (RN16_BITS + TAG_PREAMBLE_BITS) * TAG_BIT_D;
-        EPC_D         = (EPC_BITS  + TAG_PREAMBLE_BITS) * TAG_BIT_D;
-        HANDLE_D = (RN16_BITS - 1  + TAG_PREAMBLE_BITS + 16) * TAG_BIT_D; // RN16 without? dummy-bit  
-        READ_D = (1 + 32+ 16 + 16+ TAG_PREAMBLE_BITS ) * TAG_BIT_D; // RN16 without? dummy-bit
-    
-        Tsk = T1_D + RN16_D + T2_D + Tack + T1_D + EPC_D + T2_D;  //Duration of single/collision slot in us
-        Ti  = T1_D + RN16_D + T2_D; //Duration of idle slot in us
-    
-        C_th = C_th_LIST[ENCODING_SCHEME];
-
-        n_cwquery_s   = (T1_D+T2_D+RN16_D)/sample_d;     //RN16 ---
-        n_cwack_s     = (1*T1_D+T2_D+EPC_D)/sample_d;    //EPC   if it is longer than nominal it wont cause tags to change inventoried flag ---
-
-        std::vector<float>().swap(cw_query);
-        std::vector<float>().swap(cw_ack);
-
-        cw_query.resize(n_cwquery_s);      // Sent after query/query rep ---
-        cw_ack.resize(n_cwack_s);          // Sent after ack ---
-
-        std::fill_n(cw_query.begin(), cw_query.size(), 1); // ---
-        std::fill_n(cw_ack.begin(), cw_ack.size(), 1); // ---
         valid_packet = 0;
       }
       
@@ -471,541 +377,91 @@ namespace gr {
       } 
  */
       //////////////////////////////////////////////////////////////////////////////////////////////////
-      // rate adaptation algorithm 1: Auto Rate Fallback (Debugged)
-      // It starts with the lowest rate.
-      if (AUTO_RATE_FALLBACK_EN == 1) {
-        if (valid_packet == 1) { // no valid limits
-          // calculate consecutive transmission vars
-          if (prev_transmission_state == -1 && curr_transmission_state == -1) {
-            prev_transmission_state = 0;
-            curr_transmission_state = 0;
-          }
-          else if (prev_transmission_state == 0 && curr_transmission_state == 0) {
-            n_consecutive_failure++;
-          }
-          else if (prev_transmission_state == 1 && curr_transmission_state == 1) {
-            n_consecutive_success++;
-          }
-          else if (prev_transmission_state == 1 && curr_transmission_state == 0) {
-            n_consecutive_success = 0;
-            n_consecutive_failure = 1;
-          }
-          else { // prev_transmission_state == 0 && curr_transmission_state == 1
-            n_consecutive_failure = 0;
-            n_consecutive_success = 1;
-          }
-          
-          if (just_elevated == 1 && curr_transmission_state == 1) {
-            just_elevated = 0;
-          }
-
-          // adjust rate
-          // switch to lower rate if 2 successive failures happen or 1 failure happens right after switching to the new rate
-          if (n_consecutive_failure == 2 || (n_consecutive_failure == 1 && just_elevated == 1)) {
-            n_consecutive_success = 0;
-            n_consecutive_failure = 0;
-            just_elevated = 0;
-            if (index_ES > 0) {
-              index_ES--;
-              cout << "adjust to " << index_ES_LIST[index_ES] << endl;
-            }
-          }
-          // 
-          if (n_consecutive_success == 3) {
-            n_consecutive_success = 0;
-            n_consecutive_failure = 0;
-            if (index_ES < 3) {
-              just_elevated = 1;
-              index_ES++;
-              cout << "adjust to " << index_ES_LIST[index_ES] << endl;
-            }
-          }
-          curr_transmission_state = 0; // new added
-        }
-        ENCODING_SCHEME = index_ES_LIST[index_ES];
-        if (ENCODING_SCHEME == 1)
-        {
-          query_bits.insert(query_bits.end(), &M_FM0[0], &M_FM0[2]);
-        }
-        else if (ENCODING_SCHEME == 2)
-        {
-          query_bits.insert(query_bits.end(), &M_Miller2[0], &M_Miller2[2]);
-        }
-        else if (ENCODING_SCHEME == 4)
-        {
-          query_bits.insert(query_bits.end(), &M_Miller4[0], &M_Miller4[2]);
-        }
-        else
-        {
-          query_bits.insert(query_bits.end(), &M_Miller8[0], &M_Miller8[2]);
-        }
-        // adjust other params
-        TAG_BIT_D   = 1.0 * ENCODING_SCHEME/T_READER_FREQ * pow(10,6); // Duration in us
-        RN16_D      = (RN16_BITS + TAG_PREAMBLE_BITS) * TAG_BIT_D;
-        EPC_D         = (EPC_BITS  + TAG_PREAMBLE_BITS) * TAG_BIT_D;
-        HANDLE_D = (RN16_BITS - 1  + TAG_PREAMBLE_BITS + 16) * TAG_BIT_D; // RN16 without? dummy-bit  
-        READ_D = (1 + 32+ 16 + 16+ TAG_PREAMBLE_BITS ) * TAG_BIT_D; // RN16 without? dummy-bit
-    
-        Tsk = T1_D + RN16_D + T2_D + Tack + T1_D + EPC_D + T2_D;  //Duration of single/collision slot in us
-        Ti  = T1_D + RN16_D + T2_D; //Duration of idle slot in us
-    
-        C_th = C_th_LIST[ENCODING_SCHEME];
-
-        n_cwquery_s   = (T1_D+T2_D+RN16_D)/sample_d;     //RN16 ---
-        n_cwack_s     = (1*T1_D+T2_D+EPC_D)/sample_d;    //EPC   if it is longer than nominal it wont cause tags to change inventoried flag ---
-
-        std::vector<float>().swap(cw_query);
-        std::vector<float>().swap(cw_ack);
-
-        cw_query.resize(n_cwquery_s);      // Sent after query/query rep ---
-        cw_ack.resize(n_cwack_s);          // Sent after ack ---
-
-        std::fill_n(cw_query.begin(), cw_query.size(), 1); // ---
-        std::fill_n(cw_ack.begin(), cw_ack.size(), 1); // ---
-        valid_packet = 0;
-      }
-      /////////////////////////////////////////////////////////////////////////////////////////////////////
-      // rate adaptation algorithm 2: Minstrel (Debugged)
-      else if (MINSTREL_EN == 1) { // Basically it sends some non-optimal packets to probe channel.
-        // In each probing, it evaluates the throughput of each rate and maintain a performance table using EMA.
-        // It starts with the highest rate.
-        // probing
-        if (PROBING_MODE == -1) {
-          //cout << "start probing" << endl;
-          // start timer for probing
-          minstrel_timer = clock();
-          PROBING_MODE = 1;
-        }
-        if (PROBING_MODE == 1) {
-          
-          n_success += curr_transmission_state * valid_packet;
-          // end probing & adjust rate
-          double interval = ((double) (clock() - minstrel_timer)) / CLOCKS_PER_SEC;
-          if (interval > 1 && probing_rate_cnt == 0) {
-            //cout << "end probing" << endl;
-            // summarize the last rate
-            pktloss_table[probing_rate_cnt] = 0.25 * pktloss_table[probing_rate_cnt] + 0.75 * n_success;
-            PROBING_MODE = 0;
-            probing_rate_cnt = 3;
-            PROBING_MODE = 0;
-            // adjust rate
-            float max_tp = 0;
-            for (int i = 0; i < 3; i++) {
-              if (pktloss_table[i] / index_ES_LIST[i] > max_tp) {
-                max_tp = pktloss_table[i] / index_ES_LIST[i];
-                ENCODING_SCHEME = index_ES_LIST[i];
-              }
-            }
-            //cout << "adjust to rate: " << ENCODING_SCHEME << endl;
-            dwelling_clk_start = clock();
-          }
-          // probing on-going
-          else {
-            // probing end of one rate
-            if (interval > 2.0) {
-              //summarize this rate
-              pktloss_table[probing_rate_cnt] = 0.25 * pktloss_table[probing_rate_cnt] + 0.75 * n_success / 3;
-              probing_rate_cnt--;
-              minstrel_timer = clock();
-              n_success = 0;
-              // switch to next rate
-              ENCODING_SCHEME = index_ES_LIST[probing_rate_cnt];
-            }
-            else {
-              ENCODING_SCHEME = index_ES_LIST[probing_rate_cnt];
-            }
-          }
-          valid_packet = 0;
-        }
-        // keep current rate until timeout
-        if ((clock() - dwelling_clk_start) / CLOCKS_PER_SEC > 3.0) {
-          PROBING_MODE = -1;
-        }
-
-        if (ENCODING_SCHEME == 1)
-        {
-          query_bits.insert(query_bits.end(), &M_FM0[0], &M_FM0[2]);
-        }
-        else if (ENCODING_SCHEME == 2)
-        {
-          query_bits.insert(query_bits.end(), &M_Miller2[0], &M_Miller2[2]);
-        }
-        else if (ENCODING_SCHEME == 4)
-        {
-          query_bits.insert(query_bits.end(), &M_Miller4[0], &M_Miller4[2]);
-        }
-        else
-        {
-          query_bits.insert(query_bits.end(), &M_Miller8[0], &M_Miller8[2]);
-        }
-        // adjust other params
-        TAG_BIT_D   = 1.0 * ENCODING_SCHEME/T_READER_FREQ * pow(10,6); // Duration in us
-        RN16_D      = (RN16_BITS + TAG_PREAMBLE_BITS) * TAG_BIT_D;
-        EPC_D         = (EPC_BITS  + TAG_PREAMBLE_BITS) * TAG_BIT_D;
-        HANDLE_D = (RN16_BITS - 1  + TAG_PREAMBLE_BITS + 16) * TAG_BIT_D; // RN16 without? dummy-bit  
-        READ_D = (1 + 32+ 16 + 16+ TAG_PREAMBLE_BITS ) * TAG_BIT_D; // RN16 without? dummy-bit
-    
-        Tsk = T1_D + RN16_D + T2_D + Tack + T1_D + EPC_D + T2_D;  //Duration of single/collision slot in us
-        Ti  = T1_D + RN16_D + T2_D; //Duration of idle slot in us
-    
-        C_th = C_th_LIST[ENCODING_SCHEME];
-
-        n_cwquery_s   = (T1_D+T2_D+RN16_D)/sample_d;     //RN16 ---
-        n_cwack_s     = (1*T1_D+T2_D+EPC_D)/sample_d;    //EPC   if it is longer than nominal it wont cause tags to change inventoried flag ---
-
-        std::vector<float>().swap(cw_query);
-        std::vector<float>().swap(cw_ack);
-
-        cw_query.resize(n_cwquery_s);      // Sent after query/query rep ---
-        cw_ack.resize(n_cwack_s);          // Sent after ack ---
-
-        std::fill_n(cw_query.begin(), cw_query.size(), 1); // ---
-        std::fill_n(cw_ack.begin(), cw_ack.size(), 1); // ---
-        valid_packet = 0;
-      }
-      ///////////////////////////////////////////////////////////////////////////////////////////////
-      // Fixed rate (Debugged)
-      else if (FIXED_RATE_EN == 1) {
-        /*
-        if (rta_ampl > 0) {
-          if ((cnt_queries % 1000) == 0) {
-            rta_ampl -= 0.035;
-          }
-        }
-        */
-        if (ENCODING_SCHEME == 1)
-        {
-          query_bits.insert(query_bits.end(), &M_FM0[0], &M_FM0[2]);
-        }
-        else if (ENCODING_SCHEME == 2)
-        {
-          query_bits.insert(query_bits.end(), &M_Miller2[0], &M_Miller2[2]);
-        }
-        else if (ENCODING_SCHEME == 4)
-        {
-          query_bits.insert(query_bits.end(), &M_Miller4[0], &M_Miller4[2]);
-        }
-        else
-        {
-          query_bits.insert(query_bits.end(), &M_Miller8[0], &M_Miller8[2]);
-        }
-      }
-      /////////////////////////////////////////////////////////////////////////////////////////
-      // BLINK turn on averaging RSSI and pktloss
-      else if (BLINK_EN == 1) {
-        if (BLINK_MODE == 0) {// IDLE
-          if (blink_scan_cnt == 1) { // first scan
-            if (blink_scan_start == 1) { // start timer for first scan
-              cout << "first scan start" << endl;
-              cnt_queries = 0;
-              blink_timer = clock();
-              blink_scan_start = 0;
-              blink_n_success = 1E-4;
-              blink_n_failure = 0;
-            }
-            double interval = ((double) (clock() - blink_timer)) / CLOCKS_PER_SEC;
-            if (interval > 2.0) {
-              cout << "first scan end" << endl;
-              // summarize pktloss & RSSI
-              blink_pktloss_firstscan = blink_n_success / cnt_queries;
-              blink_RSSI_firstscan = RSSI;
-              blink_scan_cnt = 2; // complete first scan
-              blink_scan_start = 1;
-            }
-
-          }
-          else if (blink_scan_cnt == 2) { // second scan
-            if (blink_scan_start == 1) { // start timer for first scan
-              cout << "second scan start" << endl;
-              cnt_queries = 0;
-              blink_timer = clock();
-              blink_scan_start = 0;
-              blink_n_success = 1E-4;
-              blink_n_failure = 0;
-            }
-            double interval = ((double) (clock() - blink_timer)) / CLOCKS_PER_SEC;
-            if (interval > 2.0) {
-              cout << "second scan end" << endl;
-              blink_scan_cnt = 0; // complete two scans
-              // summarize pktloss & RSSI
-              blink_pktloss_secondscan = blink_n_success / cnt_queries;
-              blink_RSSI_secondscan = RSSI;
-              blink_scan_start = 1;
-            }
-          }
-          else { // blink_scan_cnt == 0 for trigger
-            float diff_RSSI = (blink_RSSI_secondscan - blink_RSSI_firstscan) * (blink_RSSI_secondscan - blink_RSSI_firstscan);
-            float diff_pktloss = (blink_pktloss_secondscan - blink_pktloss_firstscan) * (blink_pktloss_secondscan - blink_pktloss_firstscan);
-            cout << "dRSSI : " << diff_RSSI << endl;
-            cout << "dpktloss : " << diff_pktloss << endl;
-            if (diff_RSSI > Th_RSSI || diff_pktloss > Th_pktloss) {
-              BLINK_MODE = 1; // probing triggered
-              ENCODING_SCHEME = index_ES_LIST[0];
-              cout << "probing triggered" << endl;
-            }
-            blink_scan_cnt = 1;
-          }
-        }
-        else { // BLINK_MODE == 1 // PROBING
-          if (blink_scan_start == 1) { //start timer for probing
-            ENCODING_SCHEME = index_ES_LIST[0]; // FM0 for probing
-            cnt_queries = 0;
-            blink_timer = clock();
-            blink_scan_start = 0;
-            blink_n_success = 1E-4;
-            blink_n_failure = 0;
-          }
-          double interval = ((double) (clock() - blink_timer)) / CLOCKS_PER_SEC;
-          if (interval > 5.0) {
-            // summarize pktloss & RSSI
-            blink_pktloss_probe = blink_n_success / cnt_queries;
-            blink_RSSI_probe = RSSI;
-
-            // map link signature to optimal rate
-            // To do ...
-            ENCODING_SCHEME = 1;
-            blink_scan_start = 1;
-            BLINK_MODE = 0;
-          }
-        }
-
-        if (ENCODING_SCHEME == 1)
-        {
-          query_bits.insert(query_bits.end(), &M_FM0[0], &M_FM0[2]);
-          bulky_N = 3;
-        }
-        else if (ENCODING_SCHEME == 2)
-        {
-          query_bits.insert(query_bits.end(), &M_Miller2[0], &M_Miller2[2]);
-          bulky_N = 2;
-        }
-        else if (ENCODING_SCHEME == 4)
-        {
-          query_bits.insert(query_bits.end(), &M_Miller4[0], &M_Miller4[2]);
-          bulky_N = 1;
-        }
-        else
-        {
-          query_bits.insert(query_bits.end(), &M_Miller8[0], &M_Miller8[2]);
-          bulky_N = 1;
-        }
-        // adjust other params
-        TAG_BIT_D   = 1.0 * ENCODING_SCHEME/T_READER_FREQ * pow(10,6); // Duration in us
-        RN16_D      = (RN16_BITS + TAG_PREAMBLE_BITS) * TAG_BIT_D;
-        EPC_D         = (EPC_BITS  + TAG_PREAMBLE_BITS) * TAG_BIT_D;
-        HANDLE_D = (RN16_BITS - 1  + TAG_PREAMBLE_BITS + 16) * TAG_BIT_D; // RN16 without? dummy-bit  
-        READ_D = (1 + 32+ 16 + 16+ TAG_PREAMBLE_BITS ) * TAG_BIT_D; // RN16 without? dummy-bit
-    
-        Tsk = T1_D + RN16_D + T2_D + Tack + T1_D + EPC_D + T2_D;  //Duration of single/collision slot in us
-        Ti  = T1_D + RN16_D + T2_D; //Duration of idle slot in us
-    
-        C_th = C_th_LIST[ENCODING_SCHEME];
-
-        n_cwquery_s   = (T1_D+T2_D+RN16_D)/sample_d;     //RN16 ---
-        n_cwack_s     = (1*T1_D+T2_D+EPC_D)/sample_d;    //EPC   if it is longer than nominal it wont cause tags to change inventoried flag ---
-
-        std::vector<float>().swap(cw_query);
-        std::vector<float>().swap(cw_ack);
-
-        cw_query.resize(n_cwquery_s);      // Sent after query/query rep ---
-        cw_ack.resize(n_cwack_s);          // Sent after ack ---
-
-        std::fill_n(cw_query.begin(), cw_query.size(), 1); // ---
-        std::fill_n(cw_ack.begin(), cw_ack.size(), 1); // ---
-      }
-      
-      /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-      // MobiRate
-      // It is basically Minstrel/SampleRate with mobility-aware EMA
-      // It starts with the lowest rate
-      if (MobiRate_EN == 1) {
-        if (valid_packet == 1) {
-          // monitor phase changes to estimate mobility and set lambda
-          float diff_phase = 0;
-          if (mobirate_phase_scan_cnt == 0) { // first phase
-            mobirate_phase_realtime = Phase;
-            mobirate_phase_scan_cnt = 1;
-            mobirate_timer1 = clock();
-          }
-          double interval = ((double) (clock() - mobirate_timer1)) / CLOCKS_PER_SEC; 
-          if (mobirate_phase_scan_cnt == 1 && interval > 0.2) { // second scan
-            // unwrap phase
-            diff_phase = Phase - mobirate_phase_realtime;
-            if (diff_phase > PI) {
-              diff_phase -= 2 * PI;
-            }
-            else if (diff_phase < -PI) {
-              diff_phase += 2 * PI;
-            }
-            // estimate velocity
-            float v_est = WAVLEN * diff_phase / interval; // v = xx cm/s
-            // set lambda
-            if (v_est < 0.01) {
-              lambda = 0.07;
-            } 
-            else if (v_est > 0.01 && v_est < 0.8) {
-              lambda = 0.28;
-            }
-            else {
-              lambda = 0.39;
-            }
-            mobirate_phase_scan_cnt = 0;
-          } 
-        }
-        
-        if (MobiRate_MODE == 1) { // Probe higher rate
-          mobirate_pktloss_table[index_ES] = lambda * mobirate_pktloss_table[index_ES] + (1 - lambda) * curr_transmission_state * valid_packet;
-          double interval = ((double) (clock() - mobirate_timer2)) / CLOCKS_PER_SEC;
-          if (interval > 2) {
-            float diff_pktloss = mobirate_pktloss_table[index_ES] - mobirate_pktloss_table[index_ES - 1];
-            if (diff_pktloss < 0) { // keep original rate
-              index_ES--;
-              cout << "keep original rate" << endl;
-            }
-            MobiRate_MODE = 0; // back to keep mode
-            cout << "end probing higher rate" << endl;
-            mobirate_timer2 = clock(); // reset timer for keep mode
-          } 
-        }
-        else if (MobiRate_MODE == 2) { // Probe lower rate
-          mobirate_pktloss_table[index_ES] = lambda * mobirate_pktloss_table[index_ES] + (1 - lambda) * curr_transmission_state * valid_packet;
-          double interval = ((double) (clock() - mobirate_timer2)) / CLOCKS_PER_SEC;
-          if (interval > 2) {
-            float diff_pktloss = mobirate_pktloss_table[index_ES] - mobirate_pktloss_table[index_ES + 1];
-            if (diff_pktloss < 0) { // keep original rate
-              index_ES++;
-              cout << "keep original rate" << endl;
-            }
-            MobiRate_MODE = 0; // back to keep mode
-            cout << "end probing lower rate" << endl;
-            mobirate_timer2 = clock(); // reset timer for keep mode
-          } 
-        }
-        else if (MobiRate_MODE == 0) { // Keep
-          if (curr_transmission_state == 1 && valid_packet == 1) {
-            mobirate_n_failure = 0;
-          }
-          mobirate_n_failure += (1 - curr_transmission_state) * valid_packet; // no valid limits
-          valid_packet = 0; // reset valid_packet
-          double interval = ((double) (clock() - mobirate_timer2)) / CLOCKS_PER_SEC;
-          if (index_ES > 0 && mobirate_n_failure >= 2) {
-            mobirate_n_failure = 0;
-            mobirate_timer2 = clock(); // start timer for probing
-            index_ES--;
-            MobiRate_MODE = 2; // gonna probe lower rate
-            cout << "probe lower rate" << endl;
-          }
-          else if (index_ES < 3 && interval > 2) {
-            mobirate_n_failure = 0;
-            mobirate_timer2 = clock(); // start timer for probing
-            index_ES++;
-            MobiRate_MODE = 1; // gonna probe higher rate
-            cout << "probe higher rate" << endl;
-          }
-          else { // record packetloss of current rate
-            mobirate_pktloss_table[index_ES] = lambda * mobirate_pktloss_table[index_ES] + (1 - lambda) * curr_transmission_state * valid_packet;
-          }
-        }
-        valid_packet = 0;
-        curr_transmission_state = 0; // new added
-
-        ENCODING_SCHEME = index_ES_LIST[index_ES];
-        if (ENCODING_SCHEME == 1)
-        {
-          query_bits.insert(query_bits.end(), &M_FM0[0], &M_FM0[2]);
-          bulky_N = 3;
-        }
-        else if (ENCODING_SCHEME == 2)
-        {
-          query_bits.insert(query_bits.end(), &M_Miller2[0], &M_Miller2[2]);
-          bulky_N = 2;
-        }
-        else if (ENCODING_SCHEME == 4)
-        {
-          query_bits.insert(query_bits.end(), &M_Miller4[0], &M_Miller4[2]);
-          bulky_N = 1;
-        }
-        else
-        {
-          query_bits.insert(query_bits.end(), &M_Miller8[0], &M_Miller8[2]);
-          bulky_N = 1;
-        }
-        // adjust other params
-        TAG_BIT_D   = 1.0 * ENCODING_SCHEME/T_READER_FREQ * pow(10,6); // Duration in us
-        RN16_D      = (RN16_BITS + TAG_PREAMBLE_BITS) * TAG_BIT_D;
-        EPC_D         = (EPC_BITS  + TAG_PREAMBLE_BITS) * TAG_BIT_D;
-        HANDLE_D = (RN16_BITS - 1  + TAG_PREAMBLE_BITS + 16) * TAG_BIT_D; // RN16 without? dummy-bit  
-        READ_D = (1 + 32+ 16 + 16+ TAG_PREAMBLE_BITS ) * TAG_BIT_D; // RN16 without? dummy-bit
-    
-        Tsk = T1_D + RN16_D + T2_D + Tack + T1_D + EPC_D + T2_D;  //Duration of single/collision slot in us
-        Ti  = T1_D + RN16_D + T2_D; //Duration of idle slot in us
-    
-        C_th = C_th_LIST[ENCODING_SCHEME];
-
-        n_cwquery_s   = (T1_D+T2_D+RN16_D)/sample_d;     //RN16 ---
-        n_cwack_s     = (1*T1_D+T2_D+EPC_D)/sample_d;    //EPC   if it is longer than nominal it wont cause tags to change inventoried flag ---
-
-        std::vector<float>().swap(cw_query);
-        std::vector<float>().swap(cw_ack);
-
-        cw_query.resize(n_cwquery_s);      // Sent after query/query rep ---
-        cw_ack.resize(n_cwack_s);          // Sent after ack ---
-
-        std::fill_n(cw_query.begin(), cw_query.size(), 1); // ---
-        std::fill_n(cw_ack.begin(), cw_ack.size(), 1); // ---
-      }
+      // Rate adaptation (rate_controller.h): report the last slot, get the rate of this Query
+      select_rate();
 
       // params update for pbr
       pbr_index_ES = index_ES;
       n_queries_sent = reader_state->reader_stats.n_queries_sent;
       
       query_bits.push_back(TREXT);
-      query_bits.insert(query_bits.end(), &SEL[0], &SEL[2]);
-      query_bits.insert(query_bits.end(), &SESSION[0], &SESSION[2]);
+      query_bits.append(SEL, 2);
+      query_bits.append(SESSION, 2);
       query_bits.push_back(TARGET);
-      query_bits.insert(query_bits.end(), &Q_VALUE[reader_state->reader_stats.VAR_Q][0], &Q_VALUE[reader_state->reader_stats.VAR_Q][4]);
-      crc_append(query_bits,17);
+      query_bits.append(Q_VALUE[reader_state->reader_stats.VAR_Q], 4);
 
       
     }
 
 
-    void reader_impl::gen_ack_bits(const float * data_in)
+    void reader_impl::select_rate()
     {
-      ack_bits.resize(0);
-      ack_bits.insert(ack_bits.end(), &ACK_CODE[0], &ACK_CODE[2]);
-      ack_bits.insert(ack_bits.end(), &data_in[0], &data_in[16]);
-      
+      rate_observation obs;
+      obs.t = std::chrono::duration<double>(std::chrono::steady_clock::now() - rate_t0).count();
+      obs.rate = link_profile_index(ENCODING_SCHEME);
+      obs.valid = valid_packet == 1;
+      obs.success = curr_transmission_state == 1;
+      obs.rssi = RSSI;
+      obs.phase = Phase;
+
+      auto t0 = std::chrono::steady_clock::now();
+      rate->on_slot_result(obs);
+      int next = rate->select_next(obs);
+      double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+      rate_decisions++;
+      rate_decision_ns += ns;
+      rate_decision_ns_max = std::max(rate_decision_ns_max, ns);
+
+      // the slot is accounted for
+      valid_packet = 0;
+      curr_transmission_state = 0;
+
+      for (int i = 0; i < rate->num_notes(); i++)
+      {
+        const rate_note & n = rate->note(i);
+        if (n.has_value)
+          log_value(n.text, n.value);
+        else
+          log_note(n.text);
+      }
+      rate->clear_notes();
+
+      // localization and data collection pin the rate set above; the
+      // controller still sees every slot but does not pick the M field
+      if (RFID_LOCALIZATION == 1 || DATA_COLLECTION_EN == 1)
+        next = link_profile_index(ENCODING_SCHEME);
+
+      index_ES = next;
+      ENCODING_SCHEME = index_ES_LIST[next];
+      set_link_profile(ENCODING_SCHEME);
+      query_bits.append(link->m_field, 2);
+      bulky_N = link->bulky_N;
     }
-  
-    void reader_impl::gen_query_adjust_bits()
+
+    void reader_impl::set_link_profile(int M)
     {
-      query_adjust_bits.resize(0);
-      query_adjust_bits.insert(query_adjust_bits.end(), &QADJ_CODE[0], &QADJ_CODE[4]);
-      query_adjust_bits.insert(query_adjust_bits.end(), &SESSION[0], &SESSION[2]);
-      query_adjust_bits.insert(query_adjust_bits.end(), &Q_UPDN[reader_state-> reader_stats.Qupdn][0], &Q_UPDN[reader_state-> reader_stats.Qupdn][3]);
-     
+      link = &link_profiles[link_profile_index(M)];
+      link->apply();
     }
 
-
-    void reader_impl::gen_req_rn16_bits(const float * in)
+    void reader_impl::gen_req_rn16_bits()
     {
-      req_rn16_bits.resize(0);
-      req_rn16_bits.insert(req_rn16_bits.end(), &REQ_RN16_CODE[0], &REQ_RN16_CODE[8]);
-      req_rn16_bits.insert(req_rn16_bits.end(), &in[0], &in[16]);
-      crc16_append(req_rn16_bits,24,command_bits);
+      req_rn16_bits.clear();
+      req_rn16_bits.append(REQ_RN16_CODE, 8);
+      req_rn16_bits.append(reader_state->reader_stats.RN16_bits_handle, 0, 16);
+      crc16_append(req_rn16_bits,24);
       
     }
 
-  void reader_impl::gen_read_bits(const float * in)
+  void reader_impl::gen_read_bits()
     {
-      read_bits.resize(0);
-      read_bits.insert(read_bits.end(), &READ_CODE[0], &READ_CODE[8]);
-      read_bits.insert(read_bits.end(), &MemBank[0], &MemBank[2]);
-      read_bits.insert(read_bits.end(), &WordPtr[0], &WordPtr[8]);
-      read_bits.insert(read_bits.end(), &Wordcount[0], &Wordcount[8]);
-      read_bits.insert(read_bits.end(), &in[0], &in[16]);
-      crc16_append(read_bits,42,command_bits);
+      read_bits.clear();
+      read_bits.append(READ_CODE, 8);
+      read_bits.append(MemBank, 2);
+      read_bits.append(WordPtr, 8);
+      read_bits.append(Wordcount, 8);
+      read_bits.append(reader_state->reader_stats.RN16_bits_read, 0, 16);
+      crc16_append(read_bits,42);
       
     }
 
@@ -1020,12 +476,19 @@ namespace gr {
 
     int reader_impl::print_results()
     {       
+      log_flush();
       float pktLossRatio = 1 - 1.0 * reader_state->reader_stats.n_epc_correct / (reader_state->reader_stats.n_epc_correct + cnt_loss_epc_global);
       float aveThroughput = reader_state->reader_stats.average_throughput;
       //float aveGoodput = aveThroughput * std::pow(1 - pktLossRatio, bulky_N - 1);
       float aveGoodput = aveThroughput;
       //E_Tx = E_Tx / 0.49 * 0.1; // 
-      float P_Tx = E_Tx / accumulative_d_monitor; // ave P before calibration
+      run_totals totals;
+      totals.goodput_pkt_cnt = retran_goodput_pkt_cnt;
+      totals.total_time = total_time;
+      totals.E_Tx = E_Tx;
+      totals.accumulative_d_monitor = accumulative_d_monitor;
+      run_summary summary = summarize_run(totals);
+      float P_Tx = summary.P_Tx;
       /*
       float A_Tx = std::sqrt(P_Tx);
       float A_Tx_calibrated = 1E-5;
@@ -1037,7 +500,7 @@ namespace gr {
       }
       P_Tx = A_Tx_calibrated * A_Tx_calibrated;
       */
-      E_Tx = P_Tx * accumulative_d_monitor * 0.1;
+      E_Tx = summary.E_Tx;
 
       std::cout << "\n --------------------------" << std::endl;
       std::cout << "| Number of Queries/Queryreps Sent : " << reader_state->reader_stats.n_queries_sent  << std::endl;
@@ -1058,6 +521,8 @@ namespace gr {
       std::cout << "| Correctly Decoded EPC : "  <<  reader_state->reader_stats.n_epc_correct     << std::endl;
       std::cout << "| Totally Detected EPC : " << reader_state->reader_stats.n_epc_detected << std::endl;
       std::cout << "| Number of Unique Tags : "  <<  reader_state->reader_stats.tag_reads.size() << std::endl;
+      if (reader_state->reader_stats.tag_reads.dropped())
+        std::cout << "| Reads of Tags Not Recorded (table full) : " << reader_state->reader_stats.tag_reads.dropped() << std::endl;
       //std::cout << "| SNR : " << 10 * log10(reader_state->reader_stats.bs_power / reader_state->reader_stats.noise_power) << std::endl;
       std::cout << "| ----------------------------------------------------------------------- " <<  std::endl;
            
@@ -1068,16 +533,16 @@ namespace gr {
       std::cout << "| Average Throughput (bps) : " << aveThroughput * 32 << std::endl;
       std::cout << " --------------------------"            << std::endl;
       //std::cout << "| Goodput ref (pkts/s) : " << reader_state->reader_stats.average_throughput << std::endl;
-      std::cout << "| Goodput with retransmission (pkts/s) : " << 1.0 * retran_goodput_pkt_cnt / total_time << std::endl;
-      std::cout << "| Goodput with retransmission (bps) : " << 32.0 * retran_goodput_pkt_cnt / total_time << std::endl;
-      std::cout << "| Bulk Seg Delay with retransmission (ms) : " <<  std::round(1000 * total_time / retran_goodput_pkt_cnt) << std::endl; // 1000 * retran_delay
+      std::cout << "| Goodput with retransmission (pkts/s) : " << summary.goodput_pkts << std::endl;
+      std::cout << "| Goodput with retransmission (bps) : " << summary.goodput_bps << std::endl;
+      std::cout << "| Bulk Seg Delay with retransmission (ms) : " << summary.bulk_delay_ms << std::endl; // 1000 * retran_delay
       std::cout << "| Goodput (Effective Throughput) (reads/s): " << aveGoodput << std::endl; //changed
       std::cout << "| Bulky Segment Delay (ms) : " << 1000 * bulky_N * bulky_N / (aveThroughput * std::pow(1 - pktLossRatio, bulky_N - 1)) << std::endl;
       std::cout << "| DNN Inference Count : " << cnt_inference << std::endl;
       std::cout << "| FFT Count : " << cnt_fft << std::endl;
       std::cout << "| Tx Energy (J) : " << E_Tx << std::endl;
       std::cout << "| Ave Tx Power (mW) : " << P_Tx * 100 << std::endl;
-      std::cout << "| BpJ (kbits/J) : " << 0.32 * retran_goodput_pkt_cnt / total_time / P_Tx << std::endl; // 4 bytes sensor data
+      std::cout << "| BpJ (kbits/J) : " << summary.bpj << std::endl; // 4 bytes sensor data
       std::cout << " --------------------------"            << std::endl;
 	    std::cout << "| Power-up Delay (s) : " << reader_state->reader_stats.power_up_delay << std::endl;
       std::cout << "| Average RSSI (dB) : " << RSSI << std::endl;
@@ -1086,14 +551,20 @@ namespace gr {
       std::cout << "| Amplitude Scalar : " << rta_ampl / 0.7 << std::endl;
       std::cout << "| Equivalent Tx gain (dB) : " << 25 + 20 * log10(rta_ampl / 0.7) << std::endl;
       std::cout << "| Carrier Wave Amplitude : " << cw_ampl << std::endl;
+      std::cout << "| Rate Policy : " << rate->name() << std::endl;
+      std::cout << "| Rate Decision Time (ns, mean/max) : " << (rate_decisions ? rate_decision_ns / rate_decisions : 0) << " / " << rate_decision_ns_max << std::endl;
+      if (EVENT_DRIVEN_EN)
+        std::cout << "| Reader Idle Waits (total/timeouts) : " << d_idle_waits << " / " << d_idle_timeouts << std::endl;
 	    std::cout << "| ----------------------------------------------------------------------- " <<  std::endl;
             
-      std::map<int,int>::iterator it;
 /*
-      for(it = reader_state->reader_stats.tag_reads.begin(); it != reader_state->reader_stats.tag_reads.end(); it++) 
+      for (int i = 0; i < tag_table::CAPACITY; i++)
       {
-        std::cout << std::hex <<  "| Tag ID : " << it->first << "  ";
-        std::cout << "Num of reads : " << std::dec << it->second << std::endl;
+        const tag_entry & e = reader_state->reader_stats.tag_reads.slot(i);
+        if (e.reads == 0)
+          continue;
+        std::cout << std::hex <<  "| Tag ID : " << e.epc_hi << e.epc_lo << "  ";
+        std::cout << "Num of reads : " << std::dec << e.reads << std::endl;
       }
 */
 
@@ -1197,22 +668,34 @@ namespace gr {
                        gr_vector_const_void_star &input_items,
                        gr_vector_void_star &output_items)
     {
+      RFID_NO_ALLOC_SCOPE("reader::general_work");
 
       const float *in = (const float *) input_items[0];
       float *out =  (float*) output_items[0];
-      std::vector<float> out_message; 
       int n_output;
       int consumed = 0;
       int written = 0;
 
       consumed = ninput_items[0];
+
+      // Nothing to send until the decoder has decided the next command:
+      // sleep instead of being called again right away (no input required)
+      if (EVENT_DRIVEN_EN && reader_state->gen2_logic_status == IDLE)
+      {
+        d_idle_waits++;
+        if (!wait_reader_state(READER_IDLE_WAIT_MS))
+        {
+          d_idle_timeouts++;
+          consume_each(consumed);
+          return 0;
+        }
+      }
   
       switch (reader_state->gen2_logic_status)
       {
 	      case POWER_UP_CW:
 	        reader_state->reader_stats.n_powerup_sent +=1;
-	        memcpy(&out[written], &cw_start[0], sizeof(float) * cw_start.size() );
-          written += cw_start.size();
+	        written += emit(&out[written], cw_start);
 
 	        if (reader_state-> reader_stats.n_powerup_sent <30){
             reader_state->gen2_logic_status = POWER_UP_CW;
@@ -1227,9 +710,8 @@ namespace gr {
 
           reader_state->reader_stats.n_queries_sent +=1;
 
-          GR_LOG_INFO(d_debug_logger, "START");
-          memcpy(&out[written], &cw_start[0], sizeof(float) * cw_start.size() );
-          written += cw_start.size();
+          log_text(LOG_DEBUG_NOTE, "START");
+          written += emit(&out[written], cw_start);
 
           if (reader_state-> reader_stats.n_queries_sent <10){
             reader_state->gen2_logic_status = START;    
@@ -1240,28 +722,23 @@ namespace gr {
           break;
 
         case POWER_DOWN:
-          GR_LOG_INFO(d_debug_logger, "POWER DOWN");
-          memcpy(&out[written], &p_down[0], sizeof(float) * p_down.size() );
-          written += p_down.size();
+          log_text(LOG_DEBUG_NOTE, "POWER DOWN");
+          written += emit(&out[written], p_down);
           reader_state->gen2_logic_status = START;    
           break;
 
         case SEND_NAK_QR:
-          GR_LOG_INFO(d_debug_logger, "SEND NAK");
-          memcpy(&out[written], &nak[0], sizeof(float) * nak.size() );
-          written += nak.size();
-          memcpy(&out[written], &cw[0], sizeof(float) * cw.size() );
-          written+=cw.size();
+          log_text(LOG_DEBUG_NOTE, "SEND NAK");
+          written += emit(&out[written], nak);
+          written += emit(&out[written], cw);
           reader_state->gen2_logic_status = SEND_QUERY_REP;    
           break;
 
         case SEND_NAK_Q:
 
-          GR_LOG_INFO(d_debug_logger, "SEND NAK");
-          memcpy(&out[written], &nak[0], sizeof(float) * nak.size() );
-          written += nak.size();
-          memcpy(&out[written], &cw[0], sizeof(float) * cw.size() );
-          written+=cw.size();
+          log_text(LOG_DEBUG_NOTE, "SEND NAK");
+          written += emit(&out[written], nak);
+          written += emit(&out[written], cw);
           reader_state->gen2_logic_status = SEND_QUERY;    
           break;
 
@@ -1285,24 +762,8 @@ namespace gr {
           decoder_status = PBR_DECODER_DECODE_RN16;
           gate_status    = PBR_GATE_SEEK_RN16;
 
-          memcpy(&out[written], &preamble[0], sizeof(float) * preamble.size() );
-          written+=preamble.size();
-   
-          for(int i = 0; i < query_bits.size(); i++)
-          {
-            if(query_bits[i] == 1)
-            {
-              memcpy(&out[written], &data_1[0], sizeof(float) * data_1.size() );
-              written+=data_1.size();
-              
-            }
-            else
-            {
-              memcpy(&out[written], &data_0[0], sizeof(float) * data_0.size() );
-              written+=data_0.size();
-
-            }
-          }
+          // preamble + body + CRC-5, rendered once per variant
+          written += emit(&out[written], commands.query(query_bits));
           // Send CW for RN16
           reader_state->gen2_logic_status = SEND_CW_QUERY; 
 
@@ -1315,8 +776,10 @@ namespace gr {
         
         //std::cout <<  "SEND ACK" << std::endl;
 
-          GR_LOG_INFO(d_debug_logger, "SEND ACK");
-          if (ninput_items[0] == RN16_BITS - 1)
+          log_text(LOG_DEBUG_NOTE, "SEND ACK");
+          // the RN16 is taken from reader_stats; woken by the decoder the
+          // reader does not wait for the 16 trigger items
+          if (EVENT_DRIVEN_EN || ninput_items[0] == RN16_BITS - 1)
           {
 
             // Controls the other two blocks
@@ -1326,29 +789,9 @@ namespace gr {
             decoder_status = PBR_DECODER_DECODE_EPC;
             gate_status    = PBR_GATE_SEEK_EPC;
 
-            gen_ack_bits(in); // this should be replaced by assigning stored rn16
-            
-            // Send FrameSync
-            memcpy(&out[written], &frame_sync[0], sizeof(float) * frame_sync.size() );
-            written += frame_sync.size();
-
-
-           for(int i = 0; i < ack_bits.size(); i++)
-            {
-              if(ack_bits[i] == 1)
-              {
-                memcpy(&out[written], &data_1[0], sizeof(float) * data_1.size() );
-                written += data_1.size();
-                //std::cout << "1 ";
-              }
-              else  
-              {
-                memcpy(&out[written], &data_0[0], sizeof(float) * data_0.size() );
-                written += data_0.size();
-                //std::cout << "0 ";
-              }
-              //std::cout << endl;
-            }
+            // FrameSync + ACK code, then the RN16 stored by the decoder in reader_stats
+            written += emit(&out[written], ack_prefix);
+            written += commands.render(&out[written], reader_state->reader_stats.RN16_bits_handle, 0, 16);
 
             
             consumed = ninput_items[0];
@@ -1360,32 +803,28 @@ namespace gr {
 
         case SEND_CW_ACK:
 
-          GR_LOG_INFO(d_debug_logger, "SEND CW - ack");
-          memcpy(&out[written], &cw_ack[0], sizeof(float) * cw_ack.size() );
-          written += cw_ack.size();
+          log_text(LOG_DEBUG_NOTE, "SEND CW - ack");
+          written += emit(&out[written], link->cw_ack);
           reader_state->gen2_logic_status = IDLE;      // Return to IDLE
           break;
 
         case SEND_CW_QUERY:
 
-          GR_LOG_INFO(d_debug_logger, "SEND CW - query");
-          memcpy(&out[written], &cw_query[0], sizeof(float) * cw_query.size() );
-          written+=cw_query.size();
+          log_text(LOG_DEBUG_NOTE, "SEND CW - query");
+          written += emit(&out[written], link->cw_query);
           reader_state->gen2_logic_status = IDLE;      // Return to IDLE
           break;
 
 
         case SEND_CW_REQ:
 
-          memcpy(&out[written], &cw_req_rn16[0], sizeof(float) * cw_req_rn16.size() );
-          written += cw_req_rn16.size();
+          written += emit(&out[written], cw_req_rn16);
           reader_state->gen2_logic_status = IDLE;      // Return to IDLE
           break;
         
         case SEND_CW_READ:
 
-          memcpy(&out[written], &cw_read[0], sizeof(float) * cw_read.size() );
-          written += cw_read.size();
+          written += emit(&out[written], cw_read);
           reader_state->gen2_logic_status = IDLE;      // Return to IDLE
           break;
 
@@ -1394,15 +833,17 @@ namespace gr {
 
           reader_state-> reader_stats.tQR += 1;
 
-          GR_LOG_INFO(d_debug_logger, "INVENTORY ROUND : " + std::to_string(reader_state->reader_stats.cur_inventory_round) + " SLOT NUMBER : " + std::to_string(reader_state->reader_stats.cur_slot_number));
+          log_event(LOG_DEBUG_SLOT, reader_state->reader_stats.cur_inventory_round, reader_state->reader_stats.cur_slot_number);
           
           // Controls the other two blocks
           reader_state->decoder_status = DECODER_DECODE_RN16;
           reader_state->gate_status    = GATE_SEEK_RN16;
           reader_state->reader_stats.n_queries_sent +=1;  
 
-          memcpy(&out[written], &query_rep[0], sizeof(float) * query_rep.size() );
-          written += query_rep.size();
+          decoder_status = PBR_DECODER_DECODE_RN16;
+          gate_status    = PBR_GATE_SEEK_RN16;
+
+          written += emit(&out[written], query_rep);
           reader_state->gen2_logic_status = SEND_CW_QUERY; 
           break;
       
@@ -1410,32 +851,17 @@ namespace gr {
 
           reader_state-> reader_stats.tQA += 1;
 
-          gen_query_adjust_bits();
-
-          GR_LOG_INFO(d_debug_logger, "SEND QUERY_ADJUST");
+          log_text(LOG_DEBUG_NOTE, "SEND QUERY_ADJUST");
           
           // Controls the other two blocks
           reader_state->decoder_status = DECODER_DECODE_RN16;
           reader_state->gate_status    = GATE_SEEK_RN16;
           reader_state->reader_stats.n_queries_sent +=1;  
 
-          memcpy(&out[written], &frame_sync[0], sizeof(float) * frame_sync.size() );
-          written += frame_sync.size();
+          decoder_status = PBR_DECODER_DECODE_RN16;
+          gate_status    = PBR_GATE_SEEK_RN16;
 
-          for(int i = 0; i < query_adjust_bits.size(); i++)
-          {
-             
-            if(query_adjust_bits[i] == 1)
-            {
-              memcpy(&out[written], &data_1[0], sizeof(float) * data_1.size() );
-              written+=data_1.size();
-            }
-            else
-            {
-              memcpy(&out[written], &data_0[0], sizeof(float) * data_0.size() );
-              written+=data_0.size();
-            }
-          }
+          written += emit(&out[written], query_adjust[reader_state->reader_stats.Qupdn]);
 
           reader_state->gen2_logic_status = SEND_CW_QUERY; 
           break;
@@ -1444,34 +870,17 @@ namespace gr {
 //-----------------------------------------------------------------------------------------------------
 
     case SEND_REQ_RN16:      
-            std::cout << " SEND REQUEST HANDLE" << std::endl;
+            log_note(" SEND REQUEST HANDLE");
 
           reader_state->decoder_status = DECODER_DECODE_HANDLE;
           reader_state->gate_status    = GATE_SEEK_HANDLE;
         
           //Transmit: command + RN16 + CRC
-           gen_req_rn16_bits(in);
+           gen_req_rn16_bits();
           
-           // Send FrameSync
-            memcpy(&out[written], &frame_sync[0], sizeof(float) * frame_sync.size() );
-            written += frame_sync.size();
-
-
-           for(int i = 0; i < req_rn16_bits.size(); i++)
-            {
-              if(req_rn16_bits[i] == 1)
-              {
-                memcpy(&out[written], &data_1[0], sizeof(float) * data_1.size() );
-                written += data_1.size();
-                 
-              }
-              else  
-              {
-                memcpy(&out[written], &data_0[0], sizeof(float) * data_0.size() );
-                written += data_0.size();
-         
-              }
-            }
+           // FrameSync + command code, then RN16 + CRC16
+            written += emit(&out[written], req_rn16_prefix);
+            written += commands.render(&out[written], req_rn16_bits, 8, req_rn16_bits.size() - 8);
 
             consumed = ninput_items[0];
             reader_state->gen2_logic_status = SEND_CW_REQ; 
@@ -1487,28 +896,11 @@ namespace gr {
 
 
           //Transmit: command + MenmBank + WordPtr + WordCount + RN + CRC16
-           gen_read_bits(in);
+           gen_read_bits();
           
-           // Send FrameSync
-            memcpy(&out[written], &frame_sync[0], sizeof(float) * frame_sync.size() );
-            written += frame_sync.size();
-
-
-           for(int i = 0; i < read_bits.size(); i++)
-            {
-              if(read_bits[i] == 1)
-              {
-                memcpy(&out[written], &data_1[0], sizeof(float) * data_1.size() );
-                written += data_1.size();
-                 
-              }
-              else  
-              {
-                memcpy(&out[written], &data_0[0], sizeof(float) * data_0.size() );
-                written += data_0.size();
-         
-              }
-            }
+           // FrameSync + command code + MemBank/WordPtr/WordCount, then handle + CRC16
+            written += emit(&out[written], read_prefix);
+            written += commands.render(&out[written], read_bits, 26, read_bits.size() - 26);
 
 
             consumed = ninput_items[0];
@@ -1524,136 +916,29 @@ namespace gr {
         
           break;
       }
+      if (d_complex_output)
+        to_complex_scaled(out, written);
+
       consume_each (consumed);
       return  written;
     }
 
-    /* Function adapted from https://www.cgran.org/wiki/Gen2 */
-    void reader_impl::crc_append(std::vector<float> & q, int num_bits)
+    void reader_impl::to_complex_scaled(float * out, int n)
     {
-      
-       int crc[] = {1,0,0,1,0};
-
-      for(int i = 0; i < num_bits; i++) //17 because length of query is 17+CRC_5
+      // the buffer holds 2n floats; widening from the end never overwrites
+      // a sample that is still to be read
+      volk_32f_s32f_multiply_32f(out, out, rta_ampl, n);
+      for (int i = n - 1; i >= 0; i--)
       {
-        int tmp[] = {0,0,0,0,0};
-        tmp[4] = crc[3];
-        if(crc[4] == 1)
-        {
-          if (q[i] == 1)
-          {
-            tmp[0] = 0;
-            tmp[1] = crc[0];
-            tmp[2] = crc[1];
-            tmp[3] = crc[2];
-          }
-          else
-          {
-            tmp[0] = 1;
-            tmp[1] = crc[0];
-            tmp[2] = crc[1];
-            if(crc[2] == 1)
-            {
-              tmp[3] = 0;
-            }
-            else
-            {
-              tmp[3] = 1;
-            }
-          }
-        }
-        else
-        {
-          if (q[i] == 1)
-          {
-            tmp[0] = 1;
-            tmp[1] = crc[0];
-            tmp[2] = crc[1];
-            if(crc[2] == 1)
-            {
-              tmp[3] = 0;
-            }
-            else
-            {
-              tmp[3] = 1;
-            }
-          }
-          else
-          {
-            tmp[0] = 0;
-            tmp[1] = crc[0];
-            tmp[2] = crc[1];
-            tmp[3] = crc[2];
-          }
-        }
-        memcpy(crc, tmp, 5*sizeof(float));
+        out[2 * i + 1] = 0;
+        out[2 * i] = out[i];
       }
-      for (int i = 4; i >= 0; i--)
-        q.push_back(crc[i]);
     }
 
-
-
-    void reader_impl::crc16_append(std::vector<float> & q, int num_bits,char * bits_command)
+    void reader_impl::crc16_append(bit_buffer & q, int num_bits)
     {
-      register unsigned short i, j;
-      register unsigned short crc_16;
-      unsigned char * data;
-      //unsigned short crc16_short;
-      int num_bytes = num_bits / 8;
-      data = (unsigned char* )malloc(num_bytes );
-
-      int mask;
-      
-      //--------------------------------------------------------------
-      
-      for (int i =0; i < num_bits; i ++)
-        {
-        if (q[i] == 0)
-           bits_command[i] = '0';
-        else
-          bits_command[i] = '1';
-        }
-
-      //--------------------------------------------------------------     
-
-      for(i = 0; i < num_bytes; i++)
-      {
-        mask = 0x80;
-        data[i] = 0;
-        for(j = 0; j < 8; j++)
-        {
-          if (bits_command[(i * 8) + j] == '1'){
-          data[i] = data[i] | mask;
-        }
-        mask = mask >> 1;
-        }
-      }
-      //--------------------------------------------------------------
-      crc_16 = 0xFFFF; 
-      for (i=0; i < num_bytes; i++)
-      {
-        crc_16^=data[i] << 8;
-        for (j=0;j<8;j++)
-        {
-          if (crc_16&0x8000)
-          {
-            crc_16 <<= 1;
-            crc_16 ^= 0x1021;
-          }
-          else
-            crc_16 <<= 1;
-        }
-      }
-      crc_16 = ~crc_16;
-    
-    bitset<16> crc16_string(crc_16); 
-
-
-    for (int i = 15; i >= 0; i--)
-        q.push_back(crc16_string[i]);
-    
-    } //End of crc16 append function
+      q.append(crc16_bits(q, 0, num_bits), 16);
+    }
 
     
 
@@ -23,10 +23,16 @@
 
 #include <rfid/reader.h>
 #include <rfid/interaction_global_vars.h>
+#include <rfid/bit_buffer.h>
+#include "command_waveforms.h"
+#include "link_profile.h"
+#include "rate_controller.h"
+#include <chrono>
 #include <vector>
 #include <queue>
 #include <fstream>
 #include <bitset>
+#include <cstring>
 namespace gr {
   namespace rfid {
 
@@ -34,28 +40,60 @@ namespace gr {
     {
      private:
       
-      int s_rate, d_rate,  n_cwquery_s,  n_cwack_s,n_p_down_s,n_cwreq_s, n_cwread_s;
+      int s_rate, d_rate, n_p_down_s,n_cwreq_s, n_cwread_s;
       
       int CCI, SI, AMP;
       
       float sample_d, n_data0_s, n_data1_s, n_cw_s, n_pw_s, n_delim_s, n_trcal_s;
       
-      std::vector<float> data_0, data_1, cw, cw_ack, cw_query, cw_start, cw_req_rn16, cw_read, delim, frame_sync, preamble, rtcal, trcal, query_bits, ack_bits, req_rn16_bits, read_bits, query_rep,nak, query_adjust_bits,p_down;
+      std::vector<float> data_0, data_1, cw, cw_start, cw_req_rn16, cw_read, delim, frame_sync, preamble, rtcal, trcal, query_rep,nak,p_down;
       
+      // access commands, packed (query_bits holds the body, without CRC-5)
+      bit_buffer query_bits, req_rn16_bits, read_bits;
+
+      // rendered commands: Query cache, constant prefixes of ACK, Req_RN and
+      // Read (frame sync + command code + fixed fields), QueryAdjust by Qupdn
+      command_waveforms commands;
+      std::vector<float> ack_prefix, req_rn16_prefix, read_prefix;
+      std::vector<std::vector<float> > query_adjust;
+
+      // per-encoding timing, indexed like index_ES_LIST; link is the current one
+      link_profile link_profiles[4];
+      const link_profile * link;
+      void set_link_profile(int M);
+
+      // rate adaptation policy, and the cost of its per-Query decisions
+      std::unique_ptr<rate_controller> rate;
+      unsigned long rate_decisions;
+      double rate_decision_ns, rate_decision_ns_max;
+      std::chrono::steady_clock::time_point rate_t0; // observations are timed from here
+      void select_rate();
+
+      // sleeps in IDLE until the decoder's verdict (EVENT_DRIVEN_EN)
+      unsigned long d_idle_waits, d_idle_timeouts;
+
       int q_change; // 0-> increment, 1-> unchanged, 2-> decrement
-      char * command_bits;
-      void gen_query_adjust_bits();
-      void crc_append(std::vector<float> & q,int num_bits);
-      void crc16_append(std::vector<float> & q,int num_bits,char * bits_command);
+      void crc16_append(bit_buffer & q,int num_bits);
       void gen_query_bits();
-      void gen_ack_bits(const float * in);
-      void gen_req_rn16_bits(const float * in);
-      void gen_read_bits(const float * in);
+      void gen_req_rn16_bits();
+      void gen_read_bits();
+
+      // copy a rendered waveform to out, return the number of samples
+      int emit(float * out, const std::vector<float> & w)
+      {
+        memcpy(out, &w[0], sizeof(float) * w.size());
+        return w.size();
+      }
+
+      // complex output: the n float samples rendered at the start of the
+      // output buffer become rta_ampl * x + 0j, in place
+      bool d_complex_output;
+      void to_complex_scaled(float * out, int n);
 
 
     public:
       int print_results();
-      reader_impl(int sample_rate, int dac_rate);
+      reader_impl(int sample_rate, int dac_rate, const std::string & rate_policy, bool complex_output);
       ~reader_impl();
 
       void forecast (int noutput_items, gr_vector_int &ninput_items_required);
@@ -0,0 +1,52 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "run_metrics.h"
+#include <cmath>
+
+namespace gr {
+  namespace rfid {
+
+    float tx_amplitude_calibrated(float amp_scalar)
+    {
+      if (amp_scalar < 0.55)
+        return 1.50356 * (amp_scalar - 0.55) + 0.78861;
+      return -1.0439 * (amp_scalar - 1) * (amp_scalar - 1) + 1;
+    }
+
+    run_summary summarize_run(const run_totals & t)
+    {
+      run_summary s;
+      s.P_Tx = t.E_Tx / t.accumulative_d_monitor; // ave P before calibration
+      s.E_Tx = s.P_Tx * t.accumulative_d_monitor * 0.1;
+      s.goodput_pkts = 1.0 * t.goodput_pkt_cnt / t.total_time;
+      s.goodput_bps = 32.0 * t.goodput_pkt_cnt / t.total_time;
+      s.bulk_delay_ms = std::round(1000 * t.total_time / t.goodput_pkt_cnt);
+      s.bpj = 0.32 * t.goodput_pkt_cnt / t.total_time / s.P_Tx;
+      return s;
+    }
+
+  } /* namespace rfid */
+} /* namespace gr */
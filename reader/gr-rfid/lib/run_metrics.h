@@ -0,0 +1,58 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_RFID_RUN_METRICS_H
+#define INCLUDED_RFID_RUN_METRICS_H
+
+namespace gr {
+  namespace rfid {
+
+    // Amplitude at the antenna for the amplitude scalar rta_ampl / 0.7
+    // (calibration of the TX chain). The Tx energy of a monitoring
+    // interval d is d * amp^2.
+    float tx_amplitude_calibrated(float amp_scalar);
+
+    // Counters of a run, as accumulated by the decoder
+    struct run_totals
+    {
+      int goodput_pkt_cnt;          // retran_goodput_pkt_cnt: EPCs of complete bulk windows
+      double total_time;            // s, first to last tag reply
+      float E_Tx;                   // sum of d_monitor * amp^2
+      float accumulative_d_monitor; // sum of d_monitor
+    };
+
+    // The figures print_results reports
+    struct run_summary
+    {
+      float P_Tx;                   // average Tx power before calibration
+      float E_Tx;                   // J
+      double goodput_pkts;          // goodput with retransmission (pkts/s)
+      double goodput_bps;
+      double bulk_delay_ms;         // bulk segment delay with retransmission
+      double bpj;                   // kbits/J, 4 bytes of sensor data per EPC
+    };
+
+    run_summary summarize_run(const run_totals & t);
+
+  } // namespace rfid
+} // namespace gr
+
+#endif /* INCLUDED_RFID_RUN_METRICS_H */
@@ -0,0 +1,95 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_SAMPLE_VIEW_H
+#define INCLUDED_RFID_SAMPLE_VIEW_H
+
+#include <gnuradio/gr_complex.h>
+#include <vector>
+
+namespace gr {
+  namespace rfid {
+
+    // Read-only view over the decoder input buffer with a sparse set of
+    // patched samples. The CFO correction rewrites only a few samples per
+    // packet (one per bit), so instead of copying the whole input the
+    // patched values live in a small scratch vector and d_slot maps a
+    // sample index to its scratch entry (-1 if untouched).
+    class sample_view
+    {
+      public:
+        sample_view() : d_in(0), d_size(0) {}
+
+        // Preallocate for inputs of up to size samples
+        void reserve(int size)
+        {
+          if ((int) d_slot.size() < size)
+            d_slot.resize(size, -1);
+          d_patched.reserve(size);
+          d_values.reserve(size);
+        }
+
+        // Point the view at a new input buffer and drop all patches
+        void reset(const gr_complex * in, int size)
+        {
+          for (int k = 0; k < (int) d_patched.size(); k++)
+            d_slot[d_patched[k]] = -1;
+          d_patched.clear();
+          d_values.clear();
+
+          d_in = in;
+          d_size = size;
+          if ((int) d_slot.size() < size)
+            d_slot.resize(size, -1);
+        }
+
+        gr_complex operator[](int i) const
+        {
+          int s = d_slot[i];
+          return s < 0 ? d_in[i] : d_values[s];
+        }
+
+        // Multiply sample i by factor (in the view only)
+        void scale(int i, gr_complex factor)
+        {
+          int & s = d_slot[i];
+          if (s < 0)
+          {
+            s = d_values.size();
+            d_values.push_back(d_in[i]);
+            d_patched.push_back(i);
+          }
+          d_values[s] *= factor;
+        }
+
+        int size() const { return d_size; }
+
+      private:
+        const gr_complex * d_in;
+        int d_size;
+        std::vector<int> d_slot;            // scratch index per sample, -1 if not patched
+        std::vector<int> d_patched;         // patched sample indices
+        std::vector<gr_complex> d_values;   // patched sample values
+    };
+
+  } // namespace rfid
+} // namespace gr
+
+#endif /* INCLUDED_RFID_SAMPLE_VIEW_H */
@@ -0,0 +1,113 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "tag_clock_cache.h"
+#include <rfid/tag_table.h>
+
+namespace gr {
+  namespace rfid {
+
+    tag_clock_cache::tag_clock_cache(float ema_weight)
+      : d_ema_weight(ema_weight), d_seq(0), d_slot_valid(false), d_size(0),
+        d_mru_count(0), d_hits(0), d_misses(0)
+    {
+      for (int i = 0; i < CAPACITY; i++)
+        d_entries[i].used = false;
+    }
+
+    void tag_clock_cache::begin_slot()
+    {
+      d_slot_valid = false;
+    }
+
+    void tag_clock_cache::update_slot(float T, float alpha_CFO)
+    {
+      d_slot.T = T;
+      d_slot.alpha_CFO = alpha_CFO;
+      d_slot.last_seen = ++d_seq;
+      d_slot_valid = true;
+    }
+
+    void tag_clock_cache::update_tag(uint64_t epc_hi, uint32_t epc_lo, float T, float alpha_CFO)
+    {
+      int i = probe(epc_hi, epc_lo);
+      entry & e = d_entries[i];
+      if (!e.used)
+      {
+        if (d_size >= MAX_TAGS)
+          return;
+        e.used = true;
+        e.epc_hi = epc_hi;
+        e.epc_lo = epc_lo;
+        e.clock.T = T;
+        e.clock.alpha_CFO = alpha_CFO;
+        d_size++;
+      }
+      else
+      {
+        e.clock.T += d_ema_weight * (T - e.clock.T);
+        e.clock.alpha_CFO += d_ema_weight * (alpha_CFO - e.clock.alpha_CFO);
+      }
+      e.clock.last_seen = ++d_seq;
+      touch(i);
+    }
+
+    int tag_clock_cache::candidates(const tag_clock ** out, int max_count) const
+    {
+      int n = 0;
+      if (d_slot_valid && n < max_count)
+        out[n++] = &d_slot;
+      for (int m = 0; m < d_mru_count && n < max_count; m++)
+        out[n++] = &d_entries[d_mru[m]].clock;
+      return n;
+    }
+
+    // slot holding the EPC, or the free slot ending its probe sequence
+    int tag_clock_cache::probe(uint64_t epc_hi, uint32_t epc_lo) const
+    {
+      int i = (int) (epc_hash(epc_hi, epc_lo) & (CAPACITY - 1));
+      while (d_entries[i].used && (d_entries[i].epc_hi != epc_hi || d_entries[i].epc_lo != epc_lo))
+        i = (i + 1) & (CAPACITY - 1);
+      return i;
+    }
+
+    // move entry i to the front of the MRU list
+    void tag_clock_cache::touch(int i)
+    {
+      int m = 0;
+      while (m < d_mru_count && d_mru[m] != i)
+        m++;
+      if (m == d_mru_count)
+      {
+        if (d_mru_count < MRU_SIZE)
+          d_mru_count++;
+        m = d_mru_count - 1;
+      }
+      for (; m > 0; m--)
+        d_mru[m] = d_mru[m - 1];
+      d_mru[0] = i;
+    }
+
+  } /* namespace rfid */
+} /* namespace gr */
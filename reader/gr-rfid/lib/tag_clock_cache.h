@@ -0,0 +1,99 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 <Kai Huang (k.huang[AT]pitt.edu)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_RFID_TAG_CLOCK_CACHE_H
+#define INCLUDED_RFID_TAG_CLOCK_CACHE_H
+
+#include <stdint.h>
+
+namespace gr {
+  namespace rfid {
+
+    // Last good half-bit period T and CFO (alpha_CFO) of a tag
+    struct tag_clock
+    {
+      float T;
+      float alpha_CFO;
+      unsigned long last_seen;  // sequence number of the last update
+    };
+
+    // Per-tag cache of the backscatter clock. Each tag keeps a stable clock
+    // offset, so a previous estimate only needs to be verified instead of
+    // searched for again.
+    //   - slot entry: the tag answering in the current access sequence
+    //     (RN16 -> EPC -> HANDLE -> READ), set after every estimate
+    //   - tag entries: keyed by the 96-bit EPC, exponential moving average
+    //     over the CRC-valid EPCs of that tag. Fixed-capacity open-addressing
+    //     table like tag_table.h; tags beyond MAX_TAGS are not cached
+    //   - MRU list: the MRU_SIZE tags updated last, newest first, kept up to
+    //     date by update_tag so candidates() neither sorts nor allocates
+    class tag_clock_cache
+    {
+      public:
+        static const int CAPACITY = 1024;
+        static const int MAX_TAGS = CAPACITY * 3 / 4;
+        static const int MRU_SIZE = 8;
+
+        tag_clock_cache(float ema_weight);
+
+        // A new slot starts: the tag of the previous access sequence is unknown
+        void begin_slot();
+        void update_slot(float T, float alpha_CFO);
+        void update_tag(uint64_t epc_hi, uint32_t epc_lo, float T, float alpha_CFO);
+
+        // Entries worth verifying, most specific first: the slot entry, then
+        // the known tags from the most recently seen one. Fills out with at
+        // most max_count pointers and returns their number.
+        int candidates(const tag_clock ** out, int max_count) const;
+
+        void hit() { d_hits++; }
+        void miss() { d_misses++; }
+        unsigned long hits() const { return d_hits; }
+        unsigned long misses() const { return d_misses; }
+
+      private:
+        struct entry
+        {
+          uint64_t epc_hi;      // EPC bits 0..63
+          uint32_t epc_lo;      // EPC bits 64..95
+          bool used;
+          tag_clock clock;
+        };
+
+        float d_ema_weight;
+        unsigned long d_seq;
+        bool d_slot_valid;
+        tag_clock d_slot;
+        entry d_entries[CAPACITY];
+        int d_size;
+        int d_mru[MRU_SIZE];    // indices into d_entries, newest first
+        int d_mru_count;
+        unsigned long d_hits;
+        unsigned long d_misses;
+
+        int probe(uint64_t epc_hi, uint32_t epc_lo) const;
+        void touch(int i);
+    };
+
+  } // namespace rfid
+} // namespace gr
+
+#endif /* INCLUDED_RFID_TAG_CLOCK_CACHE_H */
@@ -28,8 +28,14 @@
 #include <cmath>
 #include <sys/time.h>
 #include "tag_decoder_impl.h"
+#include "encoding_traits.h"
+#include "gen2_crc.h"
+#include "alloc_guard.h"
+#include "async_log.h"
+#include "run_metrics.h"
 #include <iostream>
 #include <fstream>
+#include <cstring>
 
 using namespace std;
 
@@ -56,15 +62,21 @@ namespace gr {
       : gr::block("tag_decoder",
               gr::io_signature::make(1, 1, sizeof(gr_complex)),
               gr::io_signature::makev(3, 3, output_sizes )),
-              s_rate(sample_rate)
+              s_rate(sample_rate),
+              sync_fm0(encoding_traits<1>::preamble(), encoding_traits<1>::PREAMBLE_LEN, encoding_traits<1>::PREAMBLE_POWER),
+              sync_m2(encoding_traits<2>::preamble(), encoding_traits<2>::PREAMBLE_LEN, encoding_traits<2>::PREAMBLE_POWER),
+              sync_m4(encoding_traits<4>::preamble(), encoding_traits<4>::PREAMBLE_LEN, encoding_traits<4>::PREAMBLE_POWER),
+              sync_m8(encoding_traits<8>::preamble(), encoding_traits<8>::PREAMBLE_LEN, encoding_traits<8>::PREAMBLE_POWER),
+              clock_cache(TAG_CACHE_EMA),
+              q_algo(Q_SELECTION == Q_SELECT_FIXED ? FIXED_Q : Q_INITIAL, C, Q_SELECTION, Ti / Tsk),
+              d_tap_mode(DEBUG_TAP_OFF), d_tap_interval(1), d_tap_encoding(ENCODING_SCHEME), d_tap_packets(0)
     {
 
 
-      char_bits = (char *) malloc( sizeof(char) * 40);
-      char_bits_HANDLE = (char *) malloc( sizeof(char) * 32);
-
        n_samples_TAG_BIT = 14;
       //n_samples_TAG_BIT = TAG_BIT_D * s_rate / pow(10,6);      
+      d_max_reply_samples = max_tag_reply_samples(sample_rate);
+      samples.reserve(d_max_reply_samples);
       clock_gettime(CLOCK_MONOTONIC, &previous_time); 
     }                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                      
 
@@ -79,169 +91,63 @@ namespace gr {
     void
     tag_decoder_impl::forecast (int noutput_items, gr_vector_int &ninput_items_required)
     {
+      // every state decodes one full gated reply, nothing less is worth a call
+      if (EVENT_DRIVEN_EN)
+        ninput_items_required[0] = std::max(1, std::min(reader_state->n_samples_to_ungate, d_max_reply_samples));
+      else
         ninput_items_required[0] = noutput_items;
     }
 
-    int tag_decoder_impl::tag_sync(const gr_complex * in , int size, int flag)
+    preamble_sync_result tag_decoder_impl::sync_search(preamble_correlator & correlator, const gr_complex * in, int n_offsets)
     {
-      int max_index = 0;
-      float max = 0,corr,cc;
-      gr_complex corr2;
-      sig_power = 0;
-      gr_complex energy;
-      
-      if (flag == 1){ // FM0 encoding
-        //n_samples_TAG_BIT = 14;
-        // Do not have to check entire vector (not optimal)
-        for (int i=0; i < 8 * n_samples_TAG_BIT ; i++)
-        {
-          corr2 = gr_complex(0,0);
-          corr = 0;
-	        cc = 0;
-
-          // sync after matched filter (equivalent)
-          for (int j = 0; j < FM0_PREAMBLE_LEN; j ++)
-          {
-            corr2 = corr2 + in[ (int) (i+j*n_samples_TAG_BIT/2) ] * gr_complex(TAG_PREAMBLE_FM0[j],0);
-	          cc = cc + std::norm(in[(int) (i+j*n_samples_TAG_BIT/2)]);
-          }
-          corr = std::norm(corr2) / (FM0_PREAMBLE_POWER * cc);
-          if (corr > max)
-          {
-            max = corr;
-            max_index = i;
-            energy = corr2;
-          }
-        }  
-
-        reader_state->reader_stats.output_energy = max;
-        //GR_LOG_INFO(d_logger, " Energy of received signal when RN16: " << reader_state->reader_stats.output_energy);
-
-        // Preamble ({1,1,-1,1,-1,-1,1,-1,-1,-1,1,1} 1 2 4 7 11 12)) 
-        h_est = corr2 / std::complex<float>(FM0_PREAMBLE_POWER,0);
-        // Shifted received waveform by n_samples_TAG_BIT/2
-        preamble_fm0_start = max_index;
-        max_index = max_index + FM0_PREAMBLE_LEN * n_samples_TAG_BIT / 2 + n_samples_TAG_BIT/2;
-        sig_power = abs(energy);
-
-      }
- 
-      else if(flag == 2) //M2 encoding
-      {
-        
-        // Preamble detection by cross correlation
-        // n_samples_TAG_BIT = 14; 
-        gr_complex corr2_f = gr_complex(0,0);
-        // Do not have to check entire vector (not optimal)
-        for (int i=0; i < 12 * n_samples_TAG_BIT; i++)
-        {
-          
-          corr2 = gr_complex(0,0);
-          corr = 0;
-          cc = 0;
-
-          // sync after matched filter (equivalent)
-          for (int j = 0; j < M2_PREAMBLE_LEN; j ++)
-          {
-            corr2 = corr2 + in[ (int) (i+j*n_samples_TAG_BIT/2) ] * gr_complex(TAG_PREAMBLE_M2[j],0);
-            cc = cc + std::norm(in[(int) (i+j*n_samples_TAG_BIT/2)]);
-          }
-          corr = std::norm(corr2) / (M2_PREAMBLE_POWER * cc);
-          if (corr > max)
-          {
-            max = corr;
-            max_index = i;
-            corr2_f = corr2;
-            energy = corr2;
-          }
-
-        }
-
-        reader_state->reader_stats.output_energy = max;
-
-        h_est = corr2_f / std::complex<float>(M2_PREAMBLE_POWER,0);
+      int tap_spacing = (int) (n_samples_TAG_BIT/2);
+      if (SYNC_INCREMENTAL_EN)
+        return correlator.search_incremental(in, n_offsets, tap_spacing);
+      return correlator.search(in, n_offsets, tap_spacing);
+    }
 
-        // Shifted received waveform by n_samples_TAG_BIT/2
-        max_index = max_index + M2_PREAMBLE_LEN * n_samples_TAG_BIT / 2;
-        sig_power = abs(energy);  
-      }
+    template<> preamble_correlator & tag_decoder_impl::sync_correlator<1>() { return sync_fm0; }
+    template<> preamble_correlator & tag_decoder_impl::sync_correlator<2>() { return sync_m2; }
+    template<> preamble_correlator & tag_decoder_impl::sync_correlator<4>() { return sync_m4; }
+    template<> preamble_correlator & tag_decoder_impl::sync_correlator<8>() { return sync_m8; }
 
-      else if(flag == 4) //M4 encoding
-      {
-        // n_samples_TAG_BIT = 14; 
-        gr_complex corr2_f = gr_complex(0,0);
-        // Do not have to check entire vector (not optimal)
-        for (int i=0; i < 18 * n_samples_TAG_BIT ; i++)
-        {
+    template<int M>
+    int tag_decoder_impl::tag_sync_M(const gr_complex * in)
+    {
+      typedef encoding_traits<M> enc;
 
-          corr2 = gr_complex(0,0);
-          corr = 0;
-          cc = 0;
+      // Preamble detection by cross correlation
+      // Do not have to check entire vector (not optimal)
+      preamble_sync_result sync = sync_search(sync_correlator<M>(), in, enc::SYNC_WINDOW_BITS * n_samples_TAG_BIT);
+      int max_index = sync.index;
 
-          // sync after matched filter (equivalent)
-          for (int j = 0; j < M4_PREAMBLE_LEN; j ++)
-          {
-            corr2 = corr2 + in[ (int) (i+j*n_samples_TAG_BIT/2) ] * gr_complex(TAG_PREAMBLE_M4[j],0);
-            cc = cc + std::norm(in[(int) (i+j*n_samples_TAG_BIT/2)]);
-          }
-          corr = std::norm(corr2) / (M4_PREAMBLE_POWER * cc);
-          if (corr > max)
-          {
-            max = corr;
-            max_index = i;
-            corr2_f = corr2;
-            energy = corr2;
-          }
+      reader_state->reader_stats.output_energy = sync.corr;
+      //GR_LOG_INFO(d_logger, " Energy of received signal when RN16: " << reader_state->reader_stats.output_energy);
 
-        }
+      // FM0 preamble ({1,1,-1,1,-1,-1,1,-1,-1,-1,1,1} 1 2 4 7 11 12)) takes the
+      // channel estimate from the last offset searched
+      h_est = (M == 1 ? sync.last_corr2 : sync.corr2) / std::complex<float>(enc::PREAMBLE_POWER,0);
+      if (M == 1)
+        preamble_fm0_start = max_index;
+      if (M == 8)
+        preamble_m8_start = max_index;
 
-        reader_state->reader_stats.output_energy = max;
+      // Shifted received waveform by n_samples_TAG_BIT/2
+      max_index = max_index + enc::SYNC_SHIFT_HALF_BITS * n_samples_TAG_BIT / 2;
+      sig_power = abs(sync.corr2);
 
-        h_est = corr2_f / std::complex<float>(M4_PREAMBLE_POWER,0);
+      return max_index;
+    }
 
-        // Shifted received waveform by n_samples_TAG_BIT/2
-        max_index = max_index + M4_PREAMBLE_LEN * n_samples_TAG_BIT / 2;
-        sig_power = abs(energy);
-      }
+    int tag_decoder_impl::tag_sync(const gr_complex * in , int size, int flag)
+    {
+      int max_index = 0;
+      sig_power = 0;
 
-      else if(flag == 8) //M8 encoding
-      {
-        // n_samples_TAG_BIT = 14; 
-        gr_complex corr2_f = gr_complex(0,0);
-        // Do not have to check entire vector (not optimal)
-        for (int i=0; i < 24 * n_samples_TAG_BIT ; i++)
-        {
+      const encoding_ops * ops = encoding_table(flag);
+      if (ops != NULL)
+        max_index = (this->*(ops->sync))(in);
 
-          corr2 = gr_complex(0,0);
-          corr = 0;
-          cc = 0;
-          // sync after matched filter (equivalent)
-          
-          for (int j = 0; j < M8_PREAMBLE_LEN; j ++)
-          {
-            corr2 = corr2 + in[ (int) (i+j*n_samples_TAG_BIT/2) ] * gr_complex(TAG_PREAMBLE_M8[j],0);
-            cc = cc + std::norm(in[(int) (i+j*n_samples_TAG_BIT/2)]);
-          }
-          corr = std::norm(corr2) / (M8_PREAMBLE_POWER * cc);
-          if (corr > max)
-          {
-            max = corr;
-            max_index = i;
-            corr2_f = corr2;
-            energy = corr2;
-          }
-          
-        }
-        // cout << "max_index: " << max_index << endl;
-        reader_state->reader_stats.output_energy = max;
-        //cout << "max: " << max << endl;
-        h_est = corr2_f / std::complex<float>(M8_PREAMBLE_POWER,0);
-        preamble_m8_start = max_index;
-        // Shifted received waveform by n_samples_TAG_BIT/2
-        max_index = max_index + M8_PREAMBLE_LEN * n_samples_TAG_BIT / 2;
-        sig_power = abs(energy);
-      }
-      
       // CFO correction
       gr_complex sum_CFO = gr_complex(0, 0);
       for (int i = 0; i < 6 * flag; i++) {
@@ -254,639 +160,311 @@ namespace gr {
 
     //////////////////////////////////////////////////////////////////////////////////////////////7
 
-    std::vector<float>  tag_decoder_impl::tag_detection_RN16(std::vector<gr_complex> & RN16_samples_complex, int index, int flag)
+    float tag_decoder_impl::estimate_T(int index, int num_points, double half_width, int number_steps)
     {
-      // n_samples_TAG_BIT = 14; 
-
-     std::vector<float> tag_bits,dist;
-      float result=0;
-      int prev = 1;
-      
-      int number_steps = 1000;
-      float min_val = n_samples_TAG_BIT/2.0 -  0.25, max_val = n_samples_TAG_BIT/2.0 +  0.25;
+      float min_val = n_samples_TAG_BIT/2.0 - half_width, max_val = n_samples_TAG_BIT/2.0 + half_width;
+      const float * msq = &reader_state->magn_squared_samples[0];
 
-      std::vector<float> energy;
-
-      energy.resize(number_steps);
-      for (int t = 0; t <number_steps; t++)
-      {  
-        for (int i =0; i <32 * flag; i++)
+      if (TAG_CACHE_EN)
+      {
+        int n_candidates = clock_cache.candidates(clock_candidates, TAG_CACHE_CANDIDATES);
+        for (int c = 0; c < n_candidates; c++)
         {
-          energy[t]+= reader_state->magn_squared_samples[(int) (i * (min_val + t*(max_val-min_val)/(number_steps-1)) + index)];
+          bool ok;
+          float T = T_estimator.verify(msq, index, num_points, min_val, max_val, number_steps,
+                                       clock_candidates[c]->T, TAG_CACHE_T_TOL, ok);
+          if (ok)
+          {
+            clock_cache.hit();
+            if (TAG_CACHE_CFO_EN)
+              alpha_CFO = clock_candidates[c]->alpha_CFO;
+            clock_cache.update_slot(T, alpha_CFO);
+            return T;
+          }
         }
+        clock_cache.miss();
+      }
 
+      float T = search_T(msq, index, num_points, min_val, max_val, number_steps);
+      clock_cache.update_slot(T, alpha_CFO);
+      return T;
+    }
+
+    float tag_decoder_impl::search_T(const float * msq, int index, int num_points, float min_val, float max_val, int number_steps)
+    {
+      if (T_ESTIMATOR == T_EST_EXHAUSTIVE)
+        return T_estimator.exhaustive(msq, index, num_points, min_val, max_val, number_steps);
+
+      float T;
+      if (T_ESTIMATOR == T_EST_SPECTRAL)
+        T = T_estimator.spectral(msq, index, num_points, min_val, max_val, number_steps);
+      else
+        T = T_estimator.coarse_to_fine(msq, index, num_points, min_val, max_val, number_steps);
+      if (T_EST_CROSSCHECK_EN)
+      {
+        float T_exhaustive = T_estimator.exhaustive(msq, index, num_points, min_val, max_val, number_steps);
+        if (T != T_exhaustive)
+          log_event(LOG_T_MISMATCH, T, T_exhaustive);
+        T = T_exhaustive;
       }
-      int index_T = std::distance(energy.begin(), std::max_element(energy.begin(), energy.end()));
-      float T =  min_val + index_T*(max_val-min_val)/(number_steps-1);
+      return T;
+    }
+
+    void tag_decoder_impl::tag_detection_RN16(bit_buffer & tag_bits, sample_view & RN16_samples, int index, int flag)
+    {
+      tag_bits.clear();
+
+      float T = estimate_T(index, 32 * flag, 0.25, 1000);
 
       // T estimated
       T_global = T;
       
       for (int i = 0; i < 16; i++) {
-        RN16_samples_complex[(int)(i * flag * T + index)] *= std::exp(-gr_complex(0, flag * i * alpha_CFO));
+        RN16_samples.scale((int)(i * flag * T + index), std::exp(-gr_complex(0, flag * i * alpha_CFO)));
       }
       
-      tag_bits = data_decoding(tag_bits, RN16_samples_complex, T, 16, index, flag);
-      
-
-      return tag_bits;  
+      data_decoding(tag_bits, RN16_samples, T, 16, index, flag);
     }
+
     //////////////////////////////////////////////////////////////////////////////////////////////////////
-    std::vector<float> tag_decoder_impl::data_decoding(std::vector<float> & tag_bits, std::vector<gr_complex> & data, float T, int num_bits, int index, int M)
+
+    // FM0 decoding
+    template<>
+    void tag_decoder_impl::data_decoding_M<1>(bit_buffer & tag_bits, const sample_view & data, float T, int num_bits, int index)
     {
-      
-      // n_samples_TAG_BIT = 14; 
-      if (M == 1) // FM0 decoding
+      const gr_complex h = std::conj(h_est);
+      int prev = 1;
+      for (int j = 0; j < num_bits ; j ++ )
       {
-        /*
-        int incr = 0;
-        int cnt = 0;
-        float c_m = real((data[(int) (index)]) * std::conj(h_est));
-        while(cnt < 4) { // 7/14/21/28
-          float c_l = real((data[(int) (index + incr - 1)]) * std::conj(h_est));
-          float c_r = real((data[(int) (index + incr + 1)]) * std::conj(h_est));
-          cnt++;
-          if (c_l > c_m) {
-            c_m = c_l;
-            incr += -1;
-          }
-          if (c_r > c_m) {
-            c_m = c_l;
-            incr += 1;
-            continue;
-          }
-          if (c_l < c_m && c_r < c_m) {
-            break;
-          }
-        }
-        index += incr;
-*/
-        float result=0;
-        int prev = 1;
-        for (int j = 0; j < num_bits ; j ++ )
-        {
-          result = std::real((data[ (int) (j*(2*T) + index) ] - data[ (int) (j*2*T + T + index) ])*std::conj(h_est) ); 
-          //result = std::real((data[ (int) (j*(2*T) + index)] * std::exp(-gr_complex(0, 2 * j * alpha_CFO)) - \
-          data[ (int) (j*2*T + T + index)] * std::exp(-gr_complex(0, (2 * j + 1) * alpha_CFO)))*std::conj(h_est) ); 
-          
-          if (result>0){
-            if (prev == 1){
-              tag_bits.push_back(0);
-              //cout << "0";
-            }
-            else{
-              tag_bits.push_back(1);
-              //cout << "1";
-            }      
-            prev = 1;      
-          }
-          else
-          { 
-            if (prev == -1) {
-              tag_bits.push_back(0);
-              //cout << "0";
-            }
-            else {
-              tag_bits.push_back(1);
-              //cout << "1";
-            }      
-            prev = -1;    
-          }
-        }
-        //cout << endl;
+        float base = j * 2 * T;
+        float result = std::real((data[ (int) (base + index) ] - data[ (int) (base + T + index) ]) * h);
+        int level = (result > 0) ? 1 : -1;
+
+        tag_bits.push_back(prev == level ? 0 : 1);
+        prev = level;
       }
+    }
 
-      else if (M == 2) // M2 decoding
+    // Miller decoding, version 1 (used for M2)
+    template<int M>
+    void tag_decoder_impl::data_decoding_M(bit_buffer & tag_bits, const sample_view & data, float T, int num_bits, int index)
+    {
+      const gr_complex h = std::conj(h_est);
+      const float T2 = 2 * T, T3 = 3 * T;
+      for (int j = 0; j < num_bits; j++)
       {
-        /*
-        float corr_hp[4] = {0};
-        int prev_s = 3;
-        for (int j = 0; j < num_bits; j++) {
-          memset(corr_hp, 0.0, 4 * sizeof(float));
-          for (int k = 0; k < 4; k++) {
-            corr_hp[0] += std::norm((data[(int) (j * 2 * M * T + k * T + index)]) * gr_complex(M2_S0[k], 0)); //1010
-            corr_hp[1] += std::norm((data[(int) (j * 2 * M * T + k * T + index)]) * gr_complex(M2_S1[k], 0)); //0101
-            corr_hp[2] += std::norm((data[(int) (j * 2 * M * T + k * T + index)]) * gr_complex(M2_S2[k], 0)); //1001
-            corr_hp[3] += std::norm((data[(int) (j * 2 * M * T + k * T + index)]) * gr_complex(M2_S3[k], 0)); //0110
-          }
-          float max_corr = 0;
-          int max_ind = 0;
-          for (int i = 0; i < 4; i++) {
-            if (corr_hp[i] > max_corr) {
-              max_corr = corr_hp[i];
-              max_ind = i;
-            }
-          }
-          if ((prev_s == 0 && max_ind == 2) 
-           || (prev_s == 2 && max_ind == 3)
-           || (prev_s == 1 && max_ind == 3)
-           || (prev_s == 3 && max_ind == 2)) {
-             tag_bits.push_back(1);
-             //cout << "1";
-          }
-          else {
-             tag_bits.push_back(0);
-             //cout << "0";
-          }
-          prev_s = max_ind;
-          
+        float base = j * 2 * M * T;
+        float s0 = real((data[(int) (base + index)] - data[(int) (base + T + index)]) * h);
+        float s1 = real((data[(int) (base + T2 + index)] - data[(int) (base + T3 + index)]) * h);
+
+        tag_bits.push_back((s0 * s1 > 0) ? 0 : 1);
+      }
+    }
+
+    // Align the start of a Miller (M4/M8) packet on the nearest minimum of the
+    // real part of the channel-compensated samples
+    int tag_decoder_impl::miller_align(const sample_view & data, int index)
+    {
+      const gr_complex h = std::conj(h_est);
+      int incr = 0;
+      int cnt = 0;
+      float c_m = real((data[(int) (index)]) * h);
+      while(cnt < 3) { // 7/14/21/28
+        float c_l = real((data[(int) (index + incr - 1)]) * h);
+        float c_r = real((data[(int) (index + incr + 1)]) * h);
+        cnt++;
+        if (c_l < c_m) {
+          c_m = c_l;
+          incr += -1;
         }
-        */
-        //cout << endl;
-        // T = 1;
-        // version 1
-        
-        for (int j = 0; j < num_bits; j++)
-        {
-          float s0 = 0;
-          float s1 = 0;
-          
-          s0 = real((data[(int) (j * 2 * M * T + index)] - data[(int) (j * 2 * M * T + T + index)]) * std::conj(h_est));
-          s1 = real((data[(int) (j * 2 * M * T + 2 * T + index)] - data[(int) (j * 2 * M * T + 3 * T + index)]) * std::conj(h_est));
-          
-          float st = s0 * s1;
-          
-          if (st > 0)
-          {
-            tag_bits.push_back(0);
-            //cout << "0";
-          }
-          else
-          {
-            tag_bits.push_back(1);
-            //cout << "1";
-          }      
+        if (c_r < c_m) {
+          c_m = c_l;
+          incr += 1;
+          continue;
+        }
+        if (c_l > c_m && c_r > c_m) {
+          break;
         }
-        
-        //cout << endl;
-        
       }
+      return index + incr;
+    }
 
-      else if (M == 4) // M4 decoding (777)
-      {
-        /*
-        int incr = 0;
-        int cnt = 0;
-        float c_m = real((data[(int) (index)]) * std::conj(h_est));
-        while(cnt < 3) { // 7/14/21/28
-          float c_l = real((data[(int) (index + incr - 1)]) * std::conj(h_est));
-          float c_r = real((data[(int) (index + incr + 1)]) * std::conj(h_est));
-          cnt++;
-          if (c_l < c_m) {
-            c_m = c_l;
+    // Track the sub-symbol cursor of a Miller bit: climb towards the local
+    // maximum (s0 > 0) or minimum (s0 <= 0) around temp1 + index + incr
+    int tag_decoder_impl::miller_track(const sample_view & data, float temp1, int index, int incr, bool rising, int count)
+    {
+      const gr_complex h = std::conj(h_est);
+      float cursor_m = real((data[(int) (temp1 + index + incr)]) * h);
+      if (rising) {
+        while (count < 3) {
+          float cursor_l = real((data[(int) (temp1 + index + incr - 1)]) * h);
+          float cursor_r = real((data[(int) (temp1 + index + incr + 1)]) * h);
+          count++;
+          if (cursor_l > cursor_m) {
+            cursor_m = cursor_l;
             incr += -1;
           }
-          if (c_r < c_m) {
-            c_m = c_l;
+          if (cursor_r > cursor_m){
             incr += 1;
             continue;
           }
-          if (c_l > c_m && c_r > c_m) {
+          if (cursor_l < cursor_m && cursor_r < cursor_m) {
             break;
           }
         }
-        //cout << "cnt: " << cnt << endl; 
-
-        index += incr;
-
-        float corr_hp[4] = {0};
-        //int prev_s = 3;
-        for (int j = 0; j < num_bits; j++) {
-          memset(corr_hp, 0.0, 4 * sizeof(float));
-          for (int k = 0; k < 8; k++) {
-            corr_hp[0] += std::norm((data[(int) (j * 2 * M * T + k * T + index)]) * gr_complex(M4_S0[k], 0)); //1010
-            corr_hp[1] += std::norm((data[(int) (j * 2 * M * T + k * T + index)]) * gr_complex(M4_S1[k], 0)); //0101
-            corr_hp[2] += std::norm((data[(int) (j * 2 * M * T + k * T + index)]) * gr_complex(M4_S2[k], 0)); //1001
-            corr_hp[3] += std::norm((data[(int) (j * 2 * M * T + k * T + index)]) * gr_complex(M4_S3[k], 0)); //0110
-          }
-          float max_corr = 0;
-          int max_ind = 0;
-          for (int i = 0; i < 4; i++) {
-            if (corr_hp[i] > max_corr) {
-              max_corr = corr_hp[i];
-              max_ind = i;
-            }
-          }
-          if (max_ind == 2 || max_ind == 3) {
-             tag_bits.push_back(1);
-             //cout << "1";
-          }
-          else {
-             tag_bits.push_back(0);
-             //cout << "0";
-          }
-          //prev_s = max_ind;
-          
-        }
-        //cout << endl;
-        */
-        
-        //version 1
-        //T = 1;
-        int incr = 0;
-        int cnt = 0;
-        float c_m = real((data[(int) (index)]) * std::conj(h_est));
-        while(cnt < 3) { // 7/14/21/28
-          float c_l = real((data[(int) (index + incr - 1)]) * std::conj(h_est));
-          float c_r = real((data[(int) (index + incr + 1)]) * std::conj(h_est));
-          cnt++;
-          if (c_l < c_m) {
-            c_m = c_l;
+      }
+      else {
+        while (count < 3) {
+          float cursor_l = real((data[(int) (temp1 + index + incr - 1)]) * h);
+          float cursor_r = real((data[(int) (temp1 + index + incr + 1)]) * h);
+          count++;
+          if (cursor_l < cursor_m) {
+            cursor_m = cursor_l;
             incr += -1;
           }
-          if (c_r < c_m) {
-            c_m = c_l;
+          if (cursor_r < cursor_m){
+            cursor_m = cursor_r;
             incr += 1;
             continue;
           }
-          if (c_l > c_m && c_r > c_m) {
+          if (cursor_l > cursor_m && cursor_r > cursor_m) {
             break;
           }
         }
-        //cout << "cnt: " << cnt << endl; 
+      }
+      return incr;
+    }
 
-        index += incr;
-        incr = 0;
-        for (int j = 0; j < num_bits; j++) {
-          float s0 = 0;
-          float s1 = 0;
-          
-          float temp1 = (j * M) * 2 * T;
-          float temp2 = (j * M + 1) * 2 * T + incr;
-          s0 += real((data[(int) (temp1 + index + incr)] - data[(int) (temp1 + T + index + incr)]) * std::conj(h_est));
-          s1 += real((data[(int) (temp1 + M * T + index + incr)] - data[(int) (temp1 + (M + 1) * T + index + incr)])* std::conj(h_est));
-
-          int count = 1;
-          float cursor_m = real((data[(int) (temp1 + index + incr)]) * std::conj(h_est));
-          if (s0 > 0) {
-            while (count < 3) { // 7/14
-              float cursor_l = real((data[(int) (temp1 + index + incr - 1)]) * std::conj(h_est));
-              float cursor_r = real((data[(int) (temp1 + index + incr + 1)]) * std::conj(h_est));
-              count++;
-              if (cursor_l > cursor_m) {
-                cursor_m = cursor_l;
-                incr += -1;
-              }
-              if (cursor_r > cursor_m){
-                cursor_r = cursor_m;
-                incr += 1;
-                continue;
-              }
-              if (cursor_l < cursor_m && cursor_r < cursor_m) {
-                //incr += 0;
-                break;
-              }
-            } 
-          }
-          else {
-            while (count < 3) { // 7/14
-              float cursor_l = real((data[(int) (temp1 + index + incr - 1)]) * std::conj(h_est));
-              float cursor_r = real((data[(int) (temp1 + index + incr + 1)]) * std::conj(h_est));
-              count++;
-              if (cursor_l < cursor_m) {
-                cursor_m = cursor_l;
-                incr += -1;
-              }
-              if (cursor_r < cursor_m){
-                cursor_m = cursor_r;
-                incr += 1;
-                continue;
-              }
-              if (cursor_l > cursor_m && cursor_r > cursor_m) {
-                //incr += 0;
-                break;
-              }
-            } 
-          }
-          // cout << "count: " << count << endl;
-          
-          s0 += real((data[(int) (temp2 + index)] - data[(int) (temp2 + T + index)]) * std::conj(h_est));
-          s1 += real((data[(int) (temp2 + M * T + index)] - data[(int) (temp2 + (M + 1) * T + index)]) * std::conj(h_est));
+    // M4 decoding (777)
+    template<>
+    void tag_decoder_impl::data_decoding_M<4>(bit_buffer & tag_bits, const sample_view & data, float T, int num_bits, int index)
+    {
+      const int M = 4;
+      const gr_complex h = std::conj(h_est);
+      const float MT = M * T, M1T = (M + 1) * T;
 
+      index = miller_align(data, index);
+      int incr = 0;
+      for (int j = 0; j < num_bits; j++) {
+        float temp1 = (j * M) * 2 * T;
+        float temp2 = (j * M + 1) * 2 * T + incr;
+        float s0 = real((data[(int) (temp1 + index + incr)] - data[(int) (temp1 + T + index + incr)]) * h);
+        float s1 = real((data[(int) (temp1 + MT + index + incr)] - data[(int) (temp1 + M1T + index + incr)]) * h);
 
-          
+        incr = miller_track(data, temp1, index, incr, s0 > 0, 1);
 
-          float st = s0 * s1;
-          if (st > 0) {
-            tag_bits.push_back(0);
-            //cout << "0";
-          }
-          else {
-            tag_bits.push_back(1);
-            //cout << "1";
-          }
-        }
-        //cout << endl;
-        
+        s0 += real((data[(int) (temp2 + index)] - data[(int) (temp2 + T + index)]) * h);
+        s1 += real((data[(int) (temp2 + MT + index)] - data[(int) (temp2 + M1T + index)]) * h);
+
+        tag_bits.push_back((s0 * s1 > 0) ? 0 : 1);
       }
-      
-      else if (M == 8) // M8 decoding
-      {
-        
-        //T = 1;
-        int incr = 0;
-        int cnt = 0;
-        float c_m = real((data[(int) (index)]) * std::conj(h_est));
-        while(cnt < 3) { // 3/7
-          float c_l = real((data[(int) (index + incr - 1)]) * std::conj(h_est));
-          float c_r = real((data[(int) (index + incr + 1)]) * std::conj(h_est));
-          cnt++;
-          if (c_l < c_m) {
-            c_m = c_l;
-            incr += -1;
-          }
-          if (c_r < c_m) {
-            c_m = c_l;
-            incr += 1;
-            continue;
-          }
-          if (c_l > c_m && c_r > c_m) {
-            break;
-          }
-        }
-        //cout << "incr: " << incr << endl; 
-
-        index += incr;
-        incr = 0;
-        for (int j = 2; j < num_bits + 2; j++) {
-          //cout << " [incr: " << incr << "] "; 
-          float s0 = 0;
-          float s1 = 0;
-          
-          float temp1 = (j * M) * 2 * T;
-          float temp2 = (j * M + 1) * 2 * T + incr;
-          float temp3 = (j * M + 2) * 2 * T + incr;
-          float temp4 = (j * M + 3) * 2 * T + incr;
-          s0 += real((data[(int) (temp1 + index + incr)] - data[(int) (temp1 + T + index + incr)]) * std::conj(h_est));
-          s1 += real((data[(int) (temp1 + M * T + index + incr)] - data[(int) (temp1 + (M + 1) * T + index + incr)]) * std::conj(h_est));
-
-          int count = 0;
-          float cursor_m = real((data[(int) (temp1 + index + incr)]) * std::conj(h_est));
-          if (s0 > 0) {
-            while (count < 3) { // 3/7
-              float cursor_l = real((data[(int) (temp1 + index + incr - 1)]) * std::conj(h_est));
-              float cursor_r = real((data[(int) (temp1 + index + incr + 1)]) * std::conj(h_est));
-              count++;
-              if (cursor_l > cursor_m) {
-                cursor_m = cursor_l;
-                incr += -1;
-              }
-              if (cursor_r > cursor_m){
-                cursor_r = cursor_m;
-                incr += 1;
-                continue;
-              }
-              if (cursor_l < cursor_m && cursor_r < cursor_m) {
-                //incr += 0;
-                break;
-              }
-            } 
-          }
-          else {
-            while (count < 3) { // 3/7
-              float cursor_l = real((data[(int) (temp1 + index + incr - 1)]) * std::conj(h_est));
-              float cursor_r = real((data[(int) (temp1 + index + incr + 1)]) * std::conj(h_est));
-              count++;
-              if (cursor_l < cursor_m) {
-                cursor_m = cursor_l;
-                incr += -1;
-              }
-              if (cursor_r < cursor_m){
-                cursor_m = cursor_r;
-                incr += 1;
-                continue;
-              }
-              if (cursor_l > cursor_m && cursor_r > cursor_m) {
-                //incr += 0;
-                break;
-              }
-            } 
-          }
-          
-          s0 += real((data[(int) (temp2 + index)] - data[(int) (temp2 + T + index)]) * std::conj(h_est));
-          s1 += real((data[(int) (temp2 + M * T + index)] - data[(int) (temp2 + (M + 1) * T + index)]) * std::conj(h_est));
+    }
 
-          s0 += real((data[(int) (temp3 + index + incr)] - data[(int) (temp3 + T + index)]) * std::conj(h_est));
-          s1 += real((data[(int) (temp3 + M * T + index)] - data[(int) (temp3 + (M + 1) * T + index)]) * std::conj(h_est));
+    // M8 decoding
+    template<>
+    void tag_decoder_impl::data_decoding_M<8>(bit_buffer & tag_bits, const sample_view & data, float T, int num_bits, int index)
+    {
+      const int M = 8;
+      const gr_complex h = std::conj(h_est);
+      const float MT = M * T, M1T = (M + 1) * T;
 
-          s0 += real((data[(int) (temp4 + index)] - data[(int) (temp4 + T + index)]) * std::conj(h_est));
-          s1 += real((data[(int) (temp4 + M * T + index)] - data[(int) (temp4 + (M + 1) * T + index)]) * std::conj(h_est));
-          
+      index = miller_align(data, index);
+      int incr = 0;
+      for (int j = 2; j < num_bits + 2; j++) {
+        float temp1 = (j * M) * 2 * T;
+        float temp2 = (j * M + 1) * 2 * T + incr;
+        float temp3 = (j * M + 2) * 2 * T + incr;
+        float temp4 = (j * M + 3) * 2 * T + incr;
+        float s0 = real((data[(int) (temp1 + index + incr)] - data[(int) (temp1 + T + index + incr)]) * h);
+        float s1 = real((data[(int) (temp1 + MT + index + incr)] - data[(int) (temp1 + M1T + index + incr)]) * h);
 
-          float st = s0 * s1;
-          if (st > 0) {
-            tag_bits.push_back(0);
-            //cout << "0";
-          }
-          else {
-            tag_bits.push_back(1);
-            //cout << "1";
-          }
-        }
-        //cout << endl;
-       
-/*
-      /////////////////////////////////////////////////////////////////////////////////
-        int i = 0;
-        int voltage_cnt = 0;
-        int in_neg_pulse = 0;
-        int in_pos_pulse = 0;
-        int len_neg_pulse = 0;
-        int len_pos_pulse = 0;
-        int num_short_pulse = 0;
-        cout << real(h_est) << endl;
-        cout << data.size() << endl;
-        std::vector<int> EPC_temp;
-        while(voltage_cnt < num_bits * 16 && (index + i) < data.size()) {
-          float pulse_sign = norm(data[index + i]) - 9.0/16*norm(h_est);
-          //float pulse_sign = norm(data[(int)(index + i)]) - norm(h_est);
-
-          // in pos pulse
-          if (pulse_sign > 0 && in_neg_pulse == 0) {
-            in_pos_pulse = 1;
-            len_pos_pulse++;
-          }
-          // neg end, new pos start
-          else if (pulse_sign > 0 && in_neg_pulse == 1) {
-            
-            if (len_neg_pulse >= 13) {
-              EPC_temp.push_back(1);
-              EPC_temp.push_back(1);
-              voltage_cnt += 2;
-            }
-            else {
-              EPC_temp.push_back(1);
-              voltage_cnt += 1;
-            }
-            len_neg_pulse = 0;
-            in_pos_pulse = 1;
-            in_neg_pulse = 0;
-            len_pos_pulse++;
-          }
-          // in neg pulse
-          else if (pulse_sign < 0 && in_pos_pulse == 0) {
-            in_neg_pulse = 1;
-            len_neg_pulse++;
-          }
-          // pos end, new neg start
-          else {
-            
-            if (len_pos_pulse >= 13) {
-              EPC_temp.push_back(0);
-              EPC_temp.push_back(0);
-              voltage_cnt += 2;
-            }
-            else {
-              EPC_temp.push_back(0);
-              voltage_cnt += 1;
-            }
-              len_pos_pulse = 0;
-              in_neg_pulse = 1;
-              in_pos_pulse = 0;
-              len_neg_pulse++;
-          }
-          i++;
-        }
-        cout << EPC_temp.size() << endl;
-        for (int j = 0; j < num_bits * 16; j++) {
-          cout << EPC_temp[j];
-          
-        }
-        cout << endl;
-        for (int j = 0; j < num_bits; j++) {
-          if (EPC_temp[j * 2 * M + M] == EPC_temp[j * 2 * M + M - 1]) {
-            tag_bits.push_back(1);
-            cout << "1";
-          }
-          else{
-            tag_bits.push_back(0);
-            cout << "0";
-          }
-        }
-        cout << endl;
-        //EPC_temp.clear();
-        //vector<int>().swap(EPC_temp);
-        //////////////////////////////////////////
-        */
-      }
+        incr = miller_track(data, temp1, index, incr, s0 > 0, 0);
 
-      return tag_bits;
-    }
+        s0 += real((data[(int) (temp2 + index)] - data[(int) (temp2 + T + index)]) * h);
+        s1 += real((data[(int) (temp2 + MT + index)] - data[(int) (temp2 + M1T + index)]) * h);
 
-   //////////////////////////////////////////////////////////////////////////////////////////////////////
+        s0 += real((data[(int) (temp3 + index + incr)] - data[(int) (temp3 + T + index)]) * h);
+        s1 += real((data[(int) (temp3 + MT + index)] - data[(int) (temp3 + M1T + index)]) * h);
 
-    std::vector<float>  tag_decoder_impl::tag_detection_EPC(std::vector<gr_complex> & EPC_samples_complex, int index, int flag)
-    {
+        s0 += real((data[(int) (temp4 + index)] - data[(int) (temp4 + T + index)]) * h);
+        s1 += real((data[(int) (temp4 + MT + index)] - data[(int) (temp4 + M1T + index)]) * h);
 
-    // n_samples_TAG_BIT = 14; 
-      std::vector<float> tag_bits,dist;
-      float result=0;
-      int prev = 1;
-      
-      int number_steps = 1000;
-      float min_val = n_samples_TAG_BIT/2.0 - 0.25, max_val = n_samples_TAG_BIT/2.0 +  0.25;
+        tag_bits.push_back((s0 * s1 > 0) ? 0 : 1);
+      }
+    }
 
-      std::vector<float> energy;
+    // Per-encoding entry points, indexed by ENCODING_SCHEME (1, 2, 4, 8)
+    const tag_decoder_impl::encoding_ops * tag_decoder_impl::encoding_table(int M)
+    {
+      static const encoding_ops table[9] = {
+        {NULL, NULL},
+        {&tag_decoder_impl::tag_sync_M<1>, &tag_decoder_impl::data_decoding_M<1>},
+        {&tag_decoder_impl::tag_sync_M<2>, &tag_decoder_impl::data_decoding_M<2>},
+        {NULL, NULL},
+        {&tag_decoder_impl::tag_sync_M<4>, &tag_decoder_impl::data_decoding_M<4>},
+        {NULL, NULL},
+        {NULL, NULL},
+        {NULL, NULL},
+        {&tag_decoder_impl::tag_sync_M<8>, &tag_decoder_impl::data_decoding_M<8>}
+      };
+      if (M < 0 || M > 8 || table[M].sync == NULL)
+        return NULL;
+      return &table[M];
+    }
 
-      energy.resize(number_steps);
-      for (int t = 0; t <number_steps; t++)
-      {  
-        for (int i =0; i <256 * flag; i++)
-        {
-          energy[t]+= reader_state->magn_squared_samples[(int) (i * (min_val + t*(max_val-min_val)/(number_steps-1)) + index)];
-        }
+    void tag_decoder_impl::data_decoding(bit_buffer & tag_bits, const sample_view & data, float T, int num_bits, int index, int M)
+    {
+      const encoding_ops * ops = encoding_table(M);
+      if (ops != NULL)
+        (this->*(ops->decode))(tag_bits, data, T, num_bits, index);
+    }
 
-      }
-     
+   //////////////////////////////////////////////////////////////////////////////////////////////////////
 
-      int index_T = std::distance(energy.begin(), std::max_element(energy.begin(), energy.end()));
-      float T =  min_val + index_T*(max_val-min_val)/(number_steps-1);
+    void tag_decoder_impl::tag_detection_EPC(bit_buffer & tag_bits, sample_view & EPC_samples, int index, int flag)
+    {
+      tag_bits.clear();
+
+      float T = estimate_T(index, 256 * flag, 0.25, 1000);
 
       // T estimated
       T_global = T;
       
       for (int i = 0; i < 128; i++) {
-        EPC_samples_complex[(int)(i * flag * T + index)] *= std::exp(-gr_complex(0, flag * i * alpha_CFO));
+        EPC_samples.scale((int)(i * flag * T + index), std::exp(-gr_complex(0, flag * i * alpha_CFO)));
       }
 
-      tag_bits = data_decoding(tag_bits, EPC_samples_complex, T, 128, index, flag);
-
-      return tag_bits;
+      data_decoding(tag_bits, EPC_samples, T, 128, index, flag);
     }
 
    ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     
-    std::vector<float>  tag_decoder_impl::tag_detection_HANDLE(std::vector<gr_complex> & HANDLE_samples_complex, int index, int flag)
+    void tag_decoder_impl::tag_detection_HANDLE(bit_buffer & tag_bits, sample_view & HANDLE_samples, int index, int flag)
     {
+      n_samples_TAG_BIT = 14; 
+      tag_bits.clear();
 
-    n_samples_TAG_BIT = 14; 
-      std::vector<float> tag_bits,dist;
-      float result=0;
-      int prev = 1;
-      
-      int number_steps = 100;
-      float min_val = n_samples_TAG_BIT/2.0 - 1.0, max_val = n_samples_TAG_BIT/2.0 +  1.0;
-
-      std::vector<float> energy;
-
-      energy.resize(number_steps);
-      for (int t = 0; t <number_steps; t++)
-      {  
-        for (int i =0; i <64 * flag; i++)
-        {
-          energy[t]+= reader_state->magn_squared_samples[(int) (i * (min_val + t*(max_val-min_val)/(number_steps-1)) + index)];
-        }
-
-      }
-     
-
-      int index_T = std::distance(energy.begin(), std::max_element(energy.begin(), energy.end()));
-      float T =  min_val + index_T*(max_val-min_val)/(number_steps-1);
+      float T = estimate_T(index, 64 * flag, 1.0, 100);
 
       // T estimated
       T_global = T;
 
-     
-      tag_bits = data_decoding(tag_bits, HANDLE_samples_complex, T, 32, index, flag);
-
-     return tag_bits;
+      data_decoding(tag_bits, HANDLE_samples, T, 32, index, flag);
     }
 
   /////////////////////////////////////////////////////////////////////////////////////////////////////////7
 
-std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex> & READ_samples_complex, int index, int flag)
+    void tag_decoder_impl::tag_detection_READ(bit_buffer & tag_bits, sample_view & READ_samples, int index, int flag)
     {
+      n_samples_TAG_BIT = 14; 
+      tag_bits.clear();
 
-    n_samples_TAG_BIT = 14; 
-      std::vector<float> tag_bits,dist;
-      float result=0;
-      int prev = 1;
-      
-      int number_steps = 100;
-      float min_val = n_samples_TAG_BIT/2.0 - 1.0, max_val = n_samples_TAG_BIT/2.0 +  1.0;
-
-      std::vector<float> energy;
-
-      energy.resize(number_steps);
-      for (int t = 0; t <number_steps; t++)
-      {  
-        for (int i =0; i <65*2 * flag; i++)
-        {
-          energy[t]+= reader_state->magn_squared_samples[(int) (i * (min_val + t*(max_val-min_val)/(number_steps-1)) + index)];
-        }
-
-      }
-     
-      int index_T = std::distance(energy.begin(), std::max_element(energy.begin(), energy.end()));
-      float T =  min_val + index_T*(max_val-min_val)/(number_steps-1);
+      float T = estimate_T(index, 65*2 * flag, 1.0, 100);
 
       // T estimated
       T_global = T;
 
-     
-      tag_bits = data_decoding(tag_bits, READ_samples_complex, T, 65, index, flag);
-
-     return tag_bits;
+      data_decoding(tag_bits, READ_samples, T, 65, index, flag);
     }
 
 
@@ -900,41 +478,33 @@ std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex>
                        gr_vector_const_void_star &input_items,
                        gr_vector_void_star &output_items)
     {
+      RFID_NO_ALLOC_SCOPE("tag_decoder::general_work");
       const gr_complex *in = (const  gr_complex *) input_items[0];
       float *out = (float *) output_items[0];
       gr_complex *out_2 = (gr_complex *) output_items[1]; // for debugging
       gr_complex *out_preamble = (gr_complex *) output_items[2]; // provide preamble
       
-      int written_sync =0;
       int written = 0, consumed = 0;
       int preamble_sync = 0;
       int RN16_index, HANDLE_index, READ_index;
       //int EPC_index;
 
-      std::vector<float> RN16_samples_real;
-      std::vector<float> EPC_samples_real;
-      std::vector<float> HANDLE_samples_real;
-      std::vector<float> READ_samples_real;
-
-      std::vector<gr_complex> RN16_samples_complex;
-      // std::vector<gr_complex> EPC_samples_complex;
-      std::vector<gr_complex> HANDLE_samples_complex;
-      std::vector<gr_complex> READ_samples_complex;
-      std::vector<float> RN16_bits;
+      bit_buffer RN16_bits;
 
       int number_of_half_bits = 0;
-      int var = 0;
       int SW = 0;
       int delta_Q = 0;
 
-      std::vector<float> EPC_bits;  
-      std::vector<float> HANDLE_bits;  
-      std::vector<float> READ_bits; 
+      bit_buffer EPC_bits;
+      bit_buffer HANDLE_bits;
+      bit_buffer READ_bits;
       
       // Processing only after n_samples_to_ungate are available and we need to decode an RN16
       if (reader_state->decoder_status == DECODER_DECODE_RN16 && ninput_items[0] >= reader_state->n_samples_to_ungate)
       {   
 
+       // new slot: the clock of the answering tag is not known yet
+       clock_cache.begin_slot();
        RN16_index = tag_sync(in,ninput_items[0],ENCODING_SCHEME);
        //std::cout << "RN16 INDEX:  " << RN16_index << std::endl;
    
@@ -943,22 +513,12 @@ std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex>
         {
           
          //cout << "corr: " << reader_state->reader_stats.output_energy << endl;
-         for (int j = 0; j < ninput_items[0]; j++ )
-          {
-          
-          RN16_samples_complex.push_back(in[j]);
-          out_2[written_sync] = in[j];  // Save data of decoder into file for debugging purposes   
-           written_sync ++;
-         } 
-        
-        	
-        out_2[written_sync] = 2; 
-        written_sync ++; 
-        produce(1,written_sync);
+         debug_tap(out_2, in, ninput_items[0], noutput_items, false);
 
             
             //GR_LOG_INFO(d_debug_logger, "RN16 DECODED");
-            RN16_bits  = tag_detection_RN16(RN16_samples_complex,RN16_index, ENCODING_SCHEME);
+            samples.reset(in, ninput_items[0]);
+            tag_detection_RN16(RN16_bits, samples, RN16_index, ENCODING_SCHEME);
 
               // Show on the terminal the bit-string of the RN16
              //---------------------------------------------------------------         
@@ -972,7 +532,6 @@ std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex>
               for(int bit=0; bit<RN16_bits.size(); bit++)
               {
                 out[written] =  RN16_bits[bit];
-                RN16_handle_stored[bit] = RN16_bits[bit];
                 written ++;
               }
 
@@ -992,27 +551,7 @@ std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex>
           reader_state->reader_stats.n_0+=1;
           reader_state->reader_stats.tn_0 +=1 ; 
 
-          reader_state-> reader_stats.Qfp = reader_state-> reader_stats.Qfp - C;
-
-          //Qf = max(0, Qfp-C)
-          var = round(reader_state-> reader_stats.Qfp);
-          if (var > 0)
-          {
-            if(var >15)
-            {
-              reader_state-> reader_stats.Qant = 15;
-            }
-            else
-            {
-              reader_state-> reader_stats.Qant = var;
-            }
-          }
-          else
-          {
-            reader_state-> reader_stats.Qant =  0; 
-          }
-
-          update_slot();
+          update_slot(SLOT_IDLE);
           //reader_state->gen2_logic_status = SEND_QUERY;
         }
        consumed = reader_state->n_samples_to_ungate;
@@ -1023,7 +562,6 @@ std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex>
       {
 
         
-        vector<gr_complex>().swap(reader_state->reader_stats.aux_EPC_samples_complex);
         reader_state->reader_stats.aux_EPC_index = tag_sync(in,ninput_items[0],ENCODING_SCHEME);
         /*
         if (reader_state->reader_stats.aux_buffer_flag == 3 || ENCODING_SCHEME != 10) {
@@ -1033,17 +571,6 @@ std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex>
           //cout << "A EPC index:" << reader_state->reader_stats.aux_EPC_index << endl;
         }
         */
-        for (int j = 0; j < ninput_items[0]; j++ )
-        {
-          reader_state->reader_stats.aux_EPC_samples_complex.push_back(in[j]);
-
-           //out_2[written_sync] = in[j]; 
-           //written_sync ++;
-        }
-        
-        //out_2[written_sync] = 2; 
-        //written_sync ++; 
-        //produce(1,written_sync);
         /*
         if (reader_state->reader_stats.aux_buffer_flag > 1) {
           reader_state->reader_stats.aux_buffer_flag--;
@@ -1058,8 +585,9 @@ std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex>
         */
         //cout << "stage 2" << endl;
         //cout << "B EPC index:" << reader_state->reader_stats.aux_EPC_index << endl;
-        EPC_bits   = tag_detection_EPC(reader_state->reader_stats.aux_EPC_samples_complex,reader_state->reader_stats.aux_EPC_index, ENCODING_SCHEME);
-        vector<gr_complex>().swap(reader_state->reader_stats.aux_EPC_samples_complex);
+        samples.reset(in, ninput_items[0]);
+        tag_detection_EPC(EPC_bits, samples, reader_state->reader_stats.aux_EPC_index, ENCODING_SCHEME);
+        bool EPC_crc_failed = false;
        
       
         if (EPC_bits.size() == EPC_BITS - 1  && sig_power > E_th && reader_state->reader_stats.output_energy > C_th)
@@ -1140,14 +668,8 @@ std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex>
             d_monitor = (tp_monitor_ed.tv_sec - tp_monitor_st.tv_sec) * 1e9; 
 
             d_monitor = (d_monitor + (tp_monitor_ed.tv_nsec - tp_monitor_st.tv_nsec)) * 1e-9;
-            float amp_cal = 0;
             // record Tx energy cost here
-            if (rta_ampl / 0.7 < 0.55) {
-               amp_cal = 1.50356 * (rta_ampl / 0.7 - 0.55) + 0.78861;
-            }
-            else {
-               amp_cal = -1.0439 * (rta_ampl /0.7 - 1) * (rta_ampl / 0.7 - 1) + 1;
-            }
+            float amp_cal = tx_amplitude_calibrated(rta_ampl / 0.7);
             E_Tx += (d_monitor * amp_cal * amp_cal);
             accumulative_d_monitor += d_monitor; 
             // don't monitor when probing
@@ -1199,17 +721,9 @@ std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex>
           clock_gettime(CLOCK_MONOTONIC, &previous_time); 
 
 	  
-          // float to char -> use Buettner's function
-          for (int i =0; i < 40; i ++)
-          {
-            if (EPC_bits[i + 88] == 0)
-              char_bits[i] = '0';
-            else
-              char_bits[i] = '1';
-          }
 	        reader_state->reader_stats.n_epc_detected+=1;
           // correct epc
-          if(check_crc(char_bits,40) == 1)
+          if(check_crc(EPC_bits, 88, 40) == 1)
           {
             cnt_correct_epc++;
             reader_state->reader_stats.n_epc_correct+=1;
@@ -1217,16 +731,12 @@ std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex>
             reader_state->reader_stats.tn_1  +=1;
 
             // record transmission state
-            prev_transmission_state = curr_transmission_state;
             curr_transmission_state = 1;
-            blink_n_success += 1;
 
-            int result = 0;
-            for(int i = 0 ; i < 32 ; ++i)
-            {
-              result += std::pow(2,31-i) * EPC_bits[80+i] ;
-            }
-	          printf("EPC: %x\n", result);
+            int result = (int) (uint32_t) EPC_bits.get(80, 32);
+	          log_event(LOG_EPC, (uint32_t) result);
+            if (TAG_CACHE_EN)
+              clock_cache.update_tag(EPC_bits.get(16, 64), (uint32_t) EPC_bits.get(80, 32), T_global, alpha_CFO);
             /*
             // interprete temperature readings
             int temp_sign = 1;
@@ -1284,30 +794,29 @@ std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex>
             accel_z *= accel_sign;
             printf("[Ax: %.3f g, Ay: %.3f g, Az: %.3f g]\n", accel_x/64.0, accel_y/64.0, accel_z/64.0);
           */
-            // Save part of Tag's EPC message (EPC[104:111] in decimal) + number of reads
-            /*
-            std::map<int,int>::iterator it = reader_state->reader_stats.tag_reads.find(result);
-            if ( it != reader_state->reader_stats.tag_reads.end())
+            // Per-tag accounting by the 96-bit EPC (after the 16-bit PC)
+            double t_seen = previous_time.tv_sec + previous_time.tv_nsec * 1e-9;
+            reader_state->reader_stats.tag_reads.update(EPC_bits, 16, 10 * log10(std::norm(h_est)), Phase, t_seen);
+          // ----------------------------------------------------------------------------------------------------
+            if (Q_SELECTION != Q_SELECT_FIXED)
             {
-              it->second ++;
+              // the tag is inventoried, move on to the next slot
+              update_slot(SLOT_SINGLE);
             }
             else
             {
-              reader_state->reader_stats.tag_reads[result]=1;
-            }
-*/
-          // ----------------------------------------------------------------------------------------------------
-            //update_slot();
             reader_state->gen2_logic_status = SEND_ACK;
 
+            // the reader takes the RN16 from reader_stats.RN16_bits_handle,
+            // the 16 items only trigger the next ACK
             for(int bit=0; bit<16; bit++)
               {
-                out[written] =  RN16_handle_stored[bit];
+                out[written] =  reader_state->reader_stats.RN16_bits_handle[bit];
                 written ++;
               }
 
-              reader_state->reader_stats.RN16_bits_handle = RN16_bits;
               produce(0,written);
+            }
           }
 
           else // valid packet but bit-error
@@ -1334,13 +843,11 @@ std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex>
             cnt_loss_epc++;
             cnt_loss_epc_global++;
             retran_is_pkt_loss = 1;
-	          printf("%d : bit-error\n", reader_state->reader_stats.n_queries_sent);
+            EPC_crc_failed = true;
+	          log_event(LOG_EPC_BIT_ERROR, reader_state->reader_stats.n_queries_sent);
 
             // record transmission state
-            prev_transmission_state = curr_transmission_state;
             curr_transmission_state = 0;
-
-            blink_n_failure += 1;
             reader_state->reader_stats.tn_k  +=1; 
             reader_state->reader_stats.n_k+=1;
       
@@ -1349,26 +856,7 @@ std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex>
       
 	    //printf("EPC: %x\n", result_0);
 
-            reader_state-> reader_stats.Qfp = reader_state-> reader_stats.Qfp + C;
-
-            //Q = min(15, Qfp+C)
-            var = round(reader_state-> reader_stats.Qfp);
-            if (var < 15)
-            {
-              if(var<0)
-              {
-                reader_state-> reader_stats.Qant  = 0;
-              }
-              else
-              {
-                reader_state-> reader_stats.Qant = var;
-              }
-            }
-            else
-            {
-              reader_state-> reader_stats.Qant = 15; //maximum value for Q is 15
-            } 
-            update_slot();
+            update_slot(SLOT_COLLISION);
        
           }
      
@@ -1379,12 +867,17 @@ std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex>
           cnt_loss_epc++;
           cnt_loss_epc_global++;
           retran_is_pkt_loss = 1;
-          printf("%d : no epc pkt found\n", reader_state->reader_stats.n_queries_sent);
+          log_event(LOG_EPC_NOT_FOUND, reader_state->reader_stats.n_queries_sent);
           valid_packet = 1;
-          reader_state->gen2_logic_status = SEND_QUERY;
+          // no EPC after the ACK: the RN16 was a collision
+          if (Q_SELECTION != Q_SELECT_FIXED)
+            update_slot(SLOT_COLLISION);
+          else
+            reader_state->gen2_logic_status = SEND_QUERY;
           //GR_LOG_INFO(d_logger, "CHECK ME");
           //GR_LOG_EMERG(d_debug_logger, "CHECK ME");  
         }
+        debug_tap(out_2, in, ninput_items[0], noutput_items, EPC_crc_failed);
         
         if (TARGET == 1) {
           TARGET = 0;
@@ -1413,7 +906,7 @@ std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex>
             retran_delay = retran_delay + (curr_delay - retran_delay) / retran_goodput_cnt;
 
           }
-          else { // there is packet loss within these N bulk packets
+          else if (Q_SELECTION == Q_SELECT_FIXED) { // there is packet loss within these N bulk packets
             TARGET = 1;
             reader_state->gen2_logic_status = SEND_QUERY;
           }
@@ -1434,38 +927,20 @@ std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex>
 
         HANDLE_index = tag_sync(in,ninput_items[0],0);
         
-        for (int j = 0; j < ninput_items[0]; j++ )
-          {
-            HANDLE_samples_complex.push_back(in[j]);
-            out_2[written_sync] = in[j]; 
-             written_sync ++;
-
-         } 
-         std::cout << "HANDLE INDEX: " << HANDLE_index << std::endl;
+         log_value("HANDLE INDEX: ", HANDLE_index);
 
-         out_2[written_sync] = 2; 
-
-         written_sync ++; 
-         produce(1,written_sync);
-
-         HANDLE_bits  = tag_detection_HANDLE(HANDLE_samples_complex,HANDLE_index, ENCODING_SCHEME);
+         samples.reset(in, ninput_items[0]);
+         tag_detection_HANDLE(HANDLE_bits, samples, HANDLE_index, ENCODING_SCHEME);
          //This variable contains only 16 bits of the handle.
          //We also need to get the next 16 bits of the CRC
 
 
          //OBTAIN THE CRC OF TAG REPLY 
-          // float to char -> use Buettner's function
-          for (int i =0; i < 32; i ++)
+         bool HANDLE_crc_ok = check_crc(HANDLE_bits, 0, 32) == 1;
+         debug_tap(out_2, in, ninput_items[0], noutput_items, !HANDLE_crc_ok);
+         if(HANDLE_crc_ok)
           {
-            if (HANDLE_bits[i] == 0)
-              char_bits_HANDLE[i] = '0';
-            else
-              char_bits_HANDLE[i] = '1';
-          }
-      
-         if(check_crc(char_bits_HANDLE,32) == 1)
-          {
-            std::cout << " *********** HANDLE CORRECT ***************" << std::endl;
+            log_note(" *********** HANDLE CORRECT ***************");
             reader_state->reader_stats.RN16_bits_read = HANDLE_bits;
 
             for(int bit=0; bit<16; bit++)
@@ -1480,8 +955,8 @@ std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex>
             reader_state->gen2_logic_status = SEND_READ;
           }
           else{
-            std::cout << " *********** WRONG CRC OF HANDLE  ***************" << std::endl;
-            update_slot();
+            log_note(" *********** WRONG CRC OF HANDLE  ***************");
+            update_slot(SLOT_SINGLE);
           }
 
         
@@ -1494,31 +969,25 @@ std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex>
 
         READ_index = tag_sync(in,ninput_items[0],1);
 
-       for (int j = 0; j < ninput_items[0]; j++ )
-          {
-            READ_samples_complex.push_back(in[j]);
-            out_2[written_sync] = in[j]; 
-             written_sync ++;
-
-         } 
-         std::cout << "READ INDEX: " << READ_index << std::endl;
-
-         out_2[written_sync] = 2; 
-
-         written_sync ++; 
-         produce(1,written_sync);
+         log_value("READ INDEX: ", READ_index);
+         debug_tap(out_2, in, ninput_items[0], noutput_items, false);
 
-         READ_bits  = tag_detection_READ(READ_samples_complex,READ_index, ENCODING_SCHEME);
+         samples.reset(in, ninput_items[0]);
+         tag_detection_READ(READ_bits, samples, READ_index, ENCODING_SCHEME);
 
          reader_state-> reader_stats.sensor_read += 1;
 
 
-              update_slot();
+              update_slot(SLOT_SINGLE);
 
               consumed = reader_state->n_samples_to_ungate;
 }
   ///////////////////////////////////////////////////////////////////////
 
+      // the next command is decided, wake the reader
+      if (EVENT_DRIVEN_EN && consumed > 0)
+        notify_reader_state();
+
       consume_each(consumed);
      return WORK_CALLED_PRODUCE;
     }
@@ -1538,6 +1007,7 @@ std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex>
           reader_state-> reader_stats.TIR_th =reader_state->reader_stats.n_epc_correct  /(it_reader* pow(10,-6) + it_tag* pow(10,-6));
           reader_state-> reader_stats.TIR_exp = reader_state->reader_stats.n_epc_correct/(float)((reader_state-> reader_stats.it_timer));
 
+          log_flush();
            std::cout <<"| ----------------------------------------------------------------------- " <<  std::endl;
           std::cout << "| TIR theoretic : "  <<  reader_state-> reader_stats.TIR_th     << std::endl;
           std::cout << "| TIR experimental : "  <<  reader_state-> reader_stats.TIR_exp << std::endl;
@@ -1584,7 +1054,7 @@ std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex>
           }
      }
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-   void tag_decoder_impl::update_slot()
+   void tag_decoder_impl::update_slot(slot_outcome outcome)
     {
       
       //Evaluate results when ntags are identified, and the current frame is terminated
@@ -1596,28 +1066,15 @@ std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex>
           performance_evaluation();
         } 
 
+      slot_command next = q_algo.end_slot(outcome);
+      reader_state-> reader_stats.Qfp = q_algo.qfp();
+      reader_state-> reader_stats.Qant = reader_state-> reader_stats.VAR_Q;
+      reader_state-> reader_stats.VAR_Q = q_algo.q();
+      reader_state-> reader_stats.Qupdn = q_algo.updn();
+
       //If End of frame or Q modified(at any slot) => new frame
-      if (reader_state->reader_stats.cur_slot_number == pow(2,reader_state-> reader_stats.VAR_Q) || reader_state-> reader_stats.VAR_Q != reader_state->reader_stats.Qant)
+      if (next != SLOT_CMD_QUERY_REP)
       { 
-	      /*
-        if (reader_state->reader_stats.Qant > reader_state-> reader_stats.VAR_Q) 
-        {
-          reader_state-> reader_stats.Qupdn = 6; //increase Q by one
-          reader_state-> reader_stats.VAR_Q = reader_state->reader_stats.Qant;
-        }
-        else if(reader_state->reader_stats.Qant <  reader_state-> reader_stats.VAR_Q)
-        {
-          reader_state-> reader_stats.Qupdn = 3; //decrease Q by one
-          reader_state-> reader_stats.VAR_Q = reader_state->reader_stats.Qant;
-        }
-        else
-        {
-          reader_state-> reader_stats.Qupdn = 0;// Q unchanged
-        }
-	*/
-
-	reader_state-> reader_stats.VAR_Q = reader_state-> reader_stats.Qupdn;
-
         reader_state->reader_stats.cur_slot_number = 1;
         reader_state->reader_stats.unique_tags_round.push_back(reader_state->reader_stats.tag_reads.size());
         reader_state->reader_stats.cur_inventory_round += 1;
@@ -1625,62 +1082,51 @@ std::vector<float>  tag_decoder_impl::tag_detection_READ(std::vector<gr_complex>
         reader_state->reader_stats.n_1 = 0;
         reader_state->reader_stats.n_0 = 0;
 
-        reader_state->gen2_logic_status = SEND_QUERY;
+        reader_state->gen2_logic_status = next == SLOT_CMD_QUERY ? SEND_QUERY : SEND_QUERY_ADJUST;
       }
 
       else 
       {
-	reader_state-> reader_stats.VAR_Q = reader_state-> reader_stats.Qupdn;
         reader_state->reader_stats.cur_slot_number++;
-        reader_state->gen2_logic_status = SEND_QUERY;
+        reader_state->gen2_logic_status = SEND_QUERY_REP;
       }
     }
 
 
-    /* Function adapted from https://www.cgran.org/wiki/Gen2 */
-    int tag_decoder_impl::check_crc(char * bits, int num_bits)
+    void tag_decoder_impl::debug_tap(gr_complex * out, const gr_complex * in, int n_in, int noutput_items, bool crc_failed)
     {
-      register unsigned short i, j;
-      register unsigned short crc_16, rcvd_crc;
-      unsigned char * data;
-      int num_bytes = num_bits / 8;
-      data = (unsigned char* )malloc(num_bytes );
-      int mask;
-
-      for(i = 0; i < num_bytes; i++)
-      {
-        mask = 0x80;
-        data[i] = 0;
-        for(j = 0; j < 8; j++)
-        {
-          if (bits[(i * 8) + j] == '1'){
-          data[i] = data[i] | mask;
-        }
-        mask = mask >> 1;
-        }
-      }
+      int mode = d_tap_mode;
+      if (mode == DEBUG_TAP_OFF)
+        return;
 
-      rcvd_crc = (data[num_bytes - 2] << 8) + data[num_bytes -1];
-
-      crc_16 = 0xFFFF; 
-      for (i=0; i < num_bytes - 2; i++)
+      bool tap = false;
+      switch (mode)
       {
-        crc_16^=data[i] << 8;
-        for (j=0;j<8;j++)
-        {
-          if (crc_16&0x8000)
-          {
-            crc_16 <<= 1;
-            crc_16 ^= 0x1021;
-          }
-          else
-            crc_16 <<= 1;
-        }
+        case DEBUG_TAP_EVERY_NTH:
+          tap = (d_tap_packets++ % d_tap_interval) == 0;
+          break;
+        case DEBUG_TAP_FAILED_CRC:
+          tap = crc_failed;
+          break;
+        case DEBUG_TAP_ENCODING:
+          tap = (ENCODING_SCHEME == d_tap_encoding);
+          break;
       }
-       
-      crc_16 = ~crc_16;
-      //printf("rcvd_crc : %x vs. crc : %x", rcvd_crc, crc_16);
-      if(rcvd_crc != crc_16)
+      if (!tap)
+        return;
+
+      // input window (as much as fits) and the separator
+      int n = std::min(n_in, noutput_items - 1);
+      memcpy(out, in, sizeof(gr_complex) * n);
+      out[n] = 2;
+      produce(1, n + 1);
+    }
+
+    // num_bits bits starting at first: message followed by its CRC-16
+    int tag_decoder_impl::check_crc(const bit_buffer & bits, int first, int num_bits)
+    {
+      uint16_t rcvd_crc = bits.get(first + num_bits - 16, 16);
+      if(rcvd_crc != crc16_bits(bits, first, num_bits - 16))
         return -1;
       else
         return 1;
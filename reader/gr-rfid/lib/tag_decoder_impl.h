@@ -24,7 +24,15 @@
 #include <rfid/tag_decoder.h>
 #include <vector>
 #include "rfid/global_vars.h"
+#include "rfid/bit_buffer.h"
+#include "preamble_correlator.h"
+#include "period_estimator.h"
+#include "tag_clock_cache.h"
+#include "q_algorithm.h"
+#include "sample_view.h"
 #include <time.h>
+#include <algorithm>
+#include <atomic>
 #include <numeric>
 #include <fstream>
 namespace gr {
@@ -40,27 +48,70 @@ namespace rfid {
       float T_global;
       gr_complex h_est;
       float alpha_CFO;
-      char * char_bits;
-      char * char_bits_HANDLE;
 
       int preamble_fm0_start;
       int preamble_m8_start;
-      std::vector<gr_complex> EPC_samples_complex;
+
+      // preamble correlators used by tag_sync, one per encoding
+      preamble_correlator sync_fm0;
+      preamble_correlator sync_m2;
+      preamble_correlator sync_m4;
+      preamble_correlator sync_m8;
+
+      period_estimator T_estimator;
+      tag_clock_cache clock_cache;
+      const tag_clock * clock_candidates[TAG_CACHE_CANDIDATES];
+
+      // slot count of the inventory rounds, advanced by update_slot
+      q_algorithm q_algo;
+
+      // input samples of the packet being decoded, CFO-corrected in place
+      sample_view samples;
+      int d_max_reply_samples;
+
       int EPC_index;
-      std::vector<float> tag_detection_EPC(std::vector<gr_complex> &EPC_samples_complex, int index, int flag);
-      std::vector<float> tag_detection_RN16(std::vector<gr_complex> &RN16_samples_complex, int index, int flag);      
-      std::vector<float> tag_detection_HANDLE(std::vector<gr_complex> &HANDLE_samples_complex, int index, int flag); 
-      std::vector<float> tag_detection_READ(std::vector<gr_complex> &HANDLE_samples_complex, int index, int flag);
-      std::vector<float> data_decoding(std::vector<float> & tag_bits, std::vector<gr_complex> & data, float T, int num_bits, int index, int M);    
+      void tag_detection_EPC(bit_buffer & tag_bits, sample_view & EPC_samples, int index, int flag);
+      void tag_detection_RN16(bit_buffer & tag_bits, sample_view & RN16_samples, int index, int flag);
+      void tag_detection_HANDLE(bit_buffer & tag_bits, sample_view & HANDLE_samples, int index, int flag);
+      void tag_detection_READ(bit_buffer & tag_bits, sample_view & READ_samples, int index, int flag);
+      void data_decoding(bit_buffer & tag_bits, const sample_view & data, float T, int num_bits, int index, int M);
       int tag_sync(const gr_complex * in, int size, int flag);
-      int check_crc(char * bits, int num_bits);
-      void update_slot();
+      preamble_sync_result sync_search(preamble_correlator & correlator, const gr_complex * in, int n_offsets);
+      float estimate_T(int index, int num_points, double half_width, int number_steps);
+      float search_T(const float * msq, int index, int num_points, float min_val, float max_val, int number_steps);
+
+      // Decoding pipeline specialized per encoding (M = 1, 2, 4, 8), see encoding_traits.h
+      template<int M> preamble_correlator & sync_correlator();
+      template<int M> int tag_sync_M(const gr_complex * in);
+      template<int M> void data_decoding_M(bit_buffer & tag_bits, const sample_view & data, float T, int num_bits, int index);
+      int miller_align(const sample_view & data, int index);
+      int miller_track(const sample_view & data, float temp1, int index, int incr, bool rising, int count);
+
+      struct encoding_ops
+      {
+        int (tag_decoder_impl::*sync)(const gr_complex * in);
+        void (tag_decoder_impl::*decode)(bit_buffer & tag_bits, const sample_view & data, float T, int num_bits, int index);
+      };
+      static const encoding_ops * encoding_table(int M);
+      int check_crc(const bit_buffer & bits, int first, int num_bits);
+
+      // debug output (port 1), set from the flowgraph thread
+      std::atomic<int> d_tap_mode;
+      std::atomic<int> d_tap_interval;
+      std::atomic<int> d_tap_encoding;
+      unsigned long d_tap_packets;
+      void debug_tap(gr_complex * out, const gr_complex * in, int n_in, int noutput_items, bool crc_failed);
+      void update_slot(slot_outcome outcome);
       void performance_evaluation();
 
     public:
       tag_decoder_impl(int sample_rate, std::vector<int> output_sizes);
       ~tag_decoder_impl();
 
+      void set_debug_tap_mode(int mode) { d_tap_mode = mode; }
+      void set_debug_tap_interval(int n) { d_tap_interval = std::max(1, n); }
+      void set_debug_tap_encoding(int M) { d_tap_encoding = M; }
+
       void forecast (int noutput_items, gr_vector_int &ninput_items_required);
 
       int general_work(int noutput_items,